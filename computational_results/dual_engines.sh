@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Lagrangian bound and time of the dual engines (ralg, volume, bundle) on the same instances.
+# usage: dual_engines.sh <config> [states]
+# the config selects the instances (e.g. tracts); prints: state, engine, LB, Lagrangian time (s)
+
+config=$1
+shift
+states=${@:-"AL AR CT IA KS MS NE NM NV OK OR UT WV"}
+districting=${DISTRICTING:-../districting}
+
+for state in $states; do
+  for engine in ralg volume bundle; do
+    grep -v -e '^dual_engine' -e '^output' $config > engine_$engine.txt
+    echo "dual_engine $engine" >> engine_$engine.txt
+    echo "output engine_$engine.csv" >> engine_$engine.txt
+    rm -f engine_$engine.csv
+    $districting engine_$engine.txt $state > ${state}_$engine.log
+    # columns : state, model, n, k, L, U, LB, Lagrangian time, ...
+    awk -F', ' -v e=$engine '{ print $1 ", " e ", " $7 ", " $8 }' engine_$engine.csv
+  done
+done
+rm -f engine_ralg.txt engine_volume.txt engine_bundle.txt
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Lagrangian bound with double and single precision dilation matrix, hot started from the stored LP duals.
+# usage: compare_float.sh <config> <counties|tracts> [states]
+# prints: state, LP bound (last line of .ralg_hot), bound with double B, bound with float B
+
+config=$1
+level=$2
+shift 2
+states=${@:-$(ls $level | sed 's/\.ralg_hot$//')}
+districting=${DISTRICTING:-../../districting}
+hot_convert=${HOT_CONVERT:-../../hot_convert}
+model=$(grep '^model' $config | awk '{print $2}')
+
+for state in $states; do
+  hot=$level/$state.ralg_hot
+  lp=$(tail -n 1 $hot)
+  bounds=""
+  for fl in 0 1; do
+    grep -v '^ralg_float' $config > float_$fl.txt
+    echo "ralg_float $fl" >> float_$fl.txt
+    $districting float_$fl.txt $state $hot > ${state}_float_$fl.log
+    # the dumped .hot is binary, the bound is the last line of its text form
+    $hot_convert ${state}_${model}.hot bound.txt > /dev/null
+    bounds="$bounds, $(tail -n 1 bound.txt)"
+  done
+  echo "$state, $lp$bounds"
+done
+rm -f float_0.txt float_1.txt bound.txt
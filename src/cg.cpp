@@ -0,0 +1,381 @@
+// column generation over contiguous districts : set-partitioning master LP, districts priced around every center
+// by region growing and, to prove the LP bound, by a rooted connected subgraph MIP; the master IP over the
+// generated columns (price-and-branch) branches on the centers first
+#include <cstdio>
+#include <vector>
+#include <set>
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include "graph.h"
+#include "gurobi_c++.h"
+#include "models.h"
+
+using namespace std;
+
+const double CGEpsilon = 1.e-6;
+const int CGColumnsPerRound = 200;       // cheapest priced columns added per round
+const double CGPricingTimeLimit = 10.;   // seconds per center in the exact pricing
+const double CGLPShare = 0.5;            // part of the time limit for the master LP, the rest is for the IP
+
+// district of center j, cost = sum of w[i][j] over its vertices
+struct district_column
+{
+  int center;
+  vector<int> vertices;
+  double cost;
+};
+
+// cheapest district around j by region growing with profit[i] = w[i][j] - pi_i : the cheapest boundary
+// vertex is taken while the district is below L or the vertex has negative profit, U and F0 are respected
+// returns the sum of the profits, MYINFINITY if L is not reached
+static double grow_column(graph* g, const vector<int>& population, int L, int U, int j, cvv& F0,
+  const vector<double>& profit, vector<int>& vertices)
+{
+  typedef pair<double, int> pdi;
+  priority_queue<pdi, vector<pdi>, greater<pdi>> frontier;
+  vector<bool> seen(g->nr_nodes, false);
+  vertices.assign(1, j);
+  seen[j] = true;
+  long pop = population[j];
+  double sum = profit[j];
+  for (int v : g->nb(j))
+    if (!F0[v][j])
+    {
+      seen[v] = true;
+      frontier.push(make_pair(profit[v], v));
+    }
+  while (!frontier.empty())
+  {
+    pdi top = frontier.top();
+    frontier.pop();
+    int v = top.second;
+    if (pop + population[v] > U)
+      continue;
+    if (pop >= L && top.first >= 0.)
+      break;
+    vertices.push_back(v);
+    pop += population[v];
+    sum += top.first;
+    for (int u : g->nb(v))
+      if (!seen[u] && !F0[u][j])
+      {
+        seen[u] = true;
+        frontier.push(make_pair(profit[u], u));
+      }
+  }
+  return pop >= L ? sum : MYINFINITY;
+}
+
+// exact pricing of center j : min sum profit_i y_i over connected vertex sets with j and population in [L, U],
+// single-commodity flow from j; only sets cheaper than cutoff are of interest
+// returns a lower bound on the minimum (MYINFINITY if no set exists, -MYINFINITY if the solve gave no bound),
+// vertices gets a set below cutoff or stays empty
+static double price_exact(GRBEnv& env, graph* g, const vector<int>& population, int L, int U, int j, cvv& F0,
+  const vector<double>& profit, double cutoff, double time_limit, vector<int>& vertices)
+{
+  int n = g->nr_nodes;
+  vertices.clear();
+  vector<int> id(n, -1), allowed;
+  for (int i = 0; i < n; ++i)
+    if (i == j || !F0[i][j])
+    {
+      id[i] = allowed.size();
+      allowed.push_back(i);
+    }
+  int na = allowed.size();
+  GRBModel model(env);
+  model.set(GRB_IntParam_OutputFlag, 0);
+  model.set(GRB_DoubleParam_TimeLimit, time_limit);
+  model.set(GRB_DoubleParam_Cutoff, cutoff);
+  GRBVar* y = model.addVars(na, GRB_BINARY);
+  model.update();
+  y[id[j]].set(GRB_DoubleAttr_LB, 1.);
+  GRBLinExpr obj = 0, pop = 0;
+  for (int a = 0; a < na; ++a)
+  {
+    obj += profit[allowed[a]] * y[a];
+    pop += population[allowed[a]] * y[a];
+  }
+  model.setObjective(obj, GRB_MINIMIZE);
+  model.addConstr(pop >= L);
+  model.addConstr(pop <= U);
+
+  // flow f_uv on arcs between allowed vertices, nothing flows into j, every chosen vertex but j consumes one unit
+  vector<GRBLinExpr> balance(na, GRBLinExpr(0.));
+  for (int a = 0; a < na; ++a)
+    for (int v : g->nb(allowed[a]))
+    {
+      int b = id[v];
+      if (b < 0 || v == j)
+        continue;
+      GRBVar f = model.addVar(0., na - 1, 0., GRB_CONTINUOUS);
+      model.addConstr(f <= (na - 1) * y[b]);
+      if (allowed[a] != j)
+        model.addConstr(f <= (na - 1) * y[a]);
+      balance[b] += f;
+      balance[a] -= f;
+    }
+  for (int a = 0; a < na; ++a)
+    if (allowed[a] != j)
+      model.addConstr(balance[a] == y[a]);
+  model.optimize();
+
+  int status = model.get(GRB_IntAttr_Status);
+  double bound = -MYINFINITY;
+  if (status == GRB_OPTIMAL || status == GRB_TIME_LIMIT)
+    bound = model.get(GRB_DoubleAttr_ObjBound);
+  else if (status == 6) // cutoff : nothing below cutoff
+    bound = cutoff;
+  else if (status == GRB_INFEASIBLE)
+    bound = MYINFINITY;
+  if (model.get(GRB_IntAttr_SolCount) > 0 && model.get(GRB_DoubleAttr_ObjVal) < cutoff)
+  {
+    double* y_val = model.get(GRB_DoubleAttr_X, y, na);
+    for (int a = 0; a < na; ++a)
+      if (y_val[a] > 0.5)
+        vertices.push_back(allowed[a]);
+    delete[] y_val;
+  }
+  delete[] y;
+  return bound;
+}
+
+double solve_district_cg(GRBEnv& env, graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U, int k,
+  cvv& F0, const vector<int>& start, double time_limit, vector<int>& solution, double& LB, int& nr_columns, long& nodecount)
+{
+  auto cg_start = chrono::steady_clock::now();
+  auto elapsed = [&]() { return chrono::duration<double>(chrono::steady_clock::now() - cg_start).count(); };
+  int n = g->nr_nodes;
+  LB = -MYINFINITY;
+  nodecount = 0;
+  solution.clear();
+
+  // rows : every vertex once (pi_i), k districts (mu); artificials with cost M keep the master feasible
+  GRBModel model(env);
+  model.set(GRB_IntParam_OutputFlag, 0);
+  double M = 0.;
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      M = max(M, w[i][j]);
+  M = 10. * (M + 1.);
+  vector<GRBVar> art(n + 2);
+  for (int i = 0; i < n + 2; ++i)
+    art[i] = model.addVar(0., GRB_INFINITY, M, GRB_CONTINUOUS);
+  model.update();
+  vector<GRBConstr> rows(n + 1);
+  for (int i = 0; i < n; ++i)
+    rows[i] = model.addConstr(GRBLinExpr(art[i]), GRB_EQUAL, 1.);
+  rows[n] = model.addConstr(GRBLinExpr(art[n]) - GRBLinExpr(art[n + 1]), GRB_EQUAL, k);
+
+  vector<district_column> columns;
+  vector<GRBVar> var;
+  set<vector<int>> known; // center followed by the sorted vertices
+  auto add_column = [&](int j, vector<int> vertices) {
+    sort(vertices.begin(), vertices.end());
+    vector<int> key(1, j);
+    key.insert(key.end(), vertices.begin(), vertices.end());
+    if (!known.insert(key).second)
+      return false;
+    district_column c;
+    c.center = j;
+    c.cost = 0.;
+    GRBColumn col;
+    for (int i : vertices)
+    {
+      c.cost += w[i][j];
+      col.addTerm(1., rows[i]);
+    }
+    col.addTerm(1., rows[n]);
+    c.vertices = vertices;
+    var.push_back(model.addVar(0., GRB_INFINITY, c.cost, GRB_CONTINUOUS, col));
+    columns.push_back(c);
+    return true;
+  };
+
+  // the districts of the heuristic solution, only if every one is connected and holds its center
+  // (a failed contiguity heuristic leaves a partition that would otherwise become part of the answer)
+  int nr_start = 0;
+  if (static_cast<int>(start.size()) == n && find(start.begin(), start.end(), -1) == start.end())
+  {
+    vector<vector<int>> members(n);
+    for (int i = 0; i < n; ++i)
+      members[start[i]].push_back(i);
+    bool contiguous = true;
+    vector<bool> seen(n, false);
+    for (int j = 0; j < n && contiguous; ++j)
+    {
+      if (members[j].empty())
+        continue;
+      if (start[j] != j)
+      {
+        contiguous = false;
+        break;
+      }
+      vector<int> s(1, j);
+      seen[j] = true;
+      int reached = 1;
+      while (!s.empty())
+      {
+        int v = s.back(); s.pop_back();
+        for (int u : g->nb(v))
+          if (!seen[u] && start[u] == j)
+          {
+            seen[u] = true;
+            reached++;
+            s.push_back(u);
+          }
+      }
+      contiguous = reached == static_cast<int>(members[j].size());
+    }
+    if (!contiguous)
+      printf("CG : the heuristic solution is not contiguous, no start columns\n");
+    else
+      for (int j = 0; j < n; ++j)
+        if (!members[j].empty())
+          nr_start += add_column(j, members[j]);
+  }
+  model.update();
+
+  vector<double> profit(n);
+  vector<int> vertices;
+  int round = 0;
+  bool converged = false;
+  while (elapsed() < CGLPShare * time_limit)
+  {
+    round++;
+    model.optimize();
+    if (model.get(GRB_IntAttr_Status) != GRB_OPTIMAL)
+      throw "district master LP is not solved to optimality";
+    double z = model.get(GRB_DoubleAttr_ObjVal);
+    double* pi = model.get(GRB_DoubleAttr_Pi, rows.data(), n + 1);
+    double mu = pi[n];
+
+    // region growing around every center, the cheapest columns of negative reduced cost enter
+    vector<pair<double, int>> cand;
+    vector<vector<int>> cand_vertices(n);
+    for (int j = 0; j < n; ++j)
+    {
+      if (F0[j][j])
+        continue;
+      for (int i = 0; i < n; ++i)
+        profit[i] = w[i][j] - pi[i];
+      double rc = grow_column(g, population, L, U, j, F0, profit, cand_vertices[j]) - mu;
+      if (rc < -CGEpsilon)
+        cand.push_back(make_pair(rc, j));
+    }
+    sort(cand.begin(), cand.end());
+    int added = 0;
+    for (auto& c : cand)
+    {
+      if (added >= CGColumnsPerRound)
+        break;
+      added += add_column(c.second, cand_vertices[c.second]);
+    }
+
+    // no column from the heuristic : exact pricing, its bounds give the Lagrangian bound z + k min rc
+    bool exact = false;
+    if (added == 0)
+    {
+      exact = true;
+      double min_rc = 0.;
+      for (int j = 0; j < n; ++j)
+      {
+        if (F0[j][j])
+          continue;
+        double left = time_limit * CGLPShare - elapsed();
+        if (left <= 0.)
+        {
+          exact = false;
+          break;
+        }
+        for (int i = 0; i < n; ++i)
+          profit[i] = w[i][j] - pi[i];
+        double bound = price_exact(env, g, population, L, U, j, F0, profit, mu - CGEpsilon, min(left, CGPricingTimeLimit), vertices);
+        if (bound <= -MYINFINITY) // numerical trouble or an interrupt, the round gives no bound
+          exact = false;
+        else if (bound < MYINFINITY)
+          min_rc = min(min_rc, bound - mu);
+        if (!vertices.empty())
+          added += add_column(j, vertices);
+      }
+      if (exact)
+        LB = max(LB, z + k * min_rc);
+    }
+    delete[] pi;
+    printf("CG round %d : LP = %.4lf, columns = %lu, added %d%s, LB = %.4lf\n", round, z, columns.size(), added,
+      exact ? " (exact pricing)" : "", LB);
+
+    if (added > 0)
+    {
+      model.update();
+      continue;
+    }
+    if (!exact)
+      break;
+
+    // an artificial in the optimum means M is below the dual values
+    double* a = model.get(GRB_DoubleAttr_X, art.data(), n + 2);
+    double a_max = *max_element(a, a + n + 2);
+    delete[] a;
+    if (a_max > CGEpsilon)
+    {
+      M *= 10.;
+      if (M > 1.e12)
+      {
+        printf("CG : the master LP is infeasible\n");
+        return MYINFINITY;
+      }
+      for (int i = 0; i < n + 2; ++i)
+        art[i].set(GRB_DoubleAttr_Obj, M);
+      continue;
+    }
+    converged = true;
+    break;
+  }
+  nr_columns = columns.size();
+  printf("CG : %d columns (%d from the heuristic) in %d rounds, %.2lf seconds, LP %s\n", nr_columns, nr_start, round, elapsed(),
+    converged ? "optimal" : "not converged");
+
+  // price-and-branch : the master IP over the generated columns, centers z_j = sum of their columns branched first
+  for (int i = 0; i < n + 2; ++i)
+    art[i].set(GRB_DoubleAttr_UB, 0.);
+  vector<GRBLinExpr> center_expr(n, GRBLinExpr(0.));
+  for (size_t c = 0; c < columns.size(); ++c)
+  {
+    var[c].set(GRB_CharAttr_VType, GRB_BINARY);
+    var[c].set(GRB_DoubleAttr_Start, static_cast<int>(c) < nr_start ? 1. : 0.);
+    center_expr[columns[c].center] += var[c];
+  }
+  vector<int> branch_centers;
+  vector<GRBVar> z;
+  for (int j = 0; j < n; ++j)
+    if (center_expr[j].size() > 1)
+    {
+      branch_centers.push_back(j);
+      z.push_back(model.addVar(0., 1., 0., GRB_BINARY));
+    }
+  model.update();
+  for (size_t t = 0; t < z.size(); ++t)
+  {
+    z[t].set(GRB_IntAttr_BranchPriority, 1);
+    model.addConstr(GRBLinExpr(z[t]) == center_expr[branch_centers[t]]);
+  }
+  model.set(GRB_DoubleParam_TimeLimit, max(1., time_limit - elapsed()));
+  model.set(GRB_DoubleParam_MIPGap, 0.);
+  model.set(GRB_IntParam_OutputFlag, 1);
+  model.optimize();
+  nodecount = static_cast<long>(model.get(GRB_DoubleAttr_NodeCount));
+  if (model.get(GRB_IntAttr_SolCount) == 0)
+    return MYINFINITY;
+
+  double* x = model.get(GRB_DoubleAttr_X, var.data(), static_cast<int>(var.size()));
+  solution.assign(n, -1);
+  for (size_t c = 0; c < columns.size(); ++c)
+    if (x[c] > 0.5)
+      for (int i : columns[c].vertices)
+        solution[i] = columns[c].center;
+  delete[] x;
+  return model.get(GRB_DoubleAttr_ObjVal);
+}
@@ -11,14 +11,23 @@ struct hess_params
   std::vector<std::vector<bool>> F0;
   std::vector<std::vector<bool>> F1;
   std::unordered_map<int, int> h;
+  std::vector<int> var_i; // inverse of h : variable index -> i
+  std::vector<int> var_j; // inverse of h : variable index -> j
   int n;
   int infty;
+  // district population rows of build_hess, for update_hess_population
+  std::vector<int> pop_center; // center j of district_population[t]
+  GRBVar* district_population;
+  std::vector<GRBConstr> pop_rows; // sum_i p_i x_ij - district_population[t] = 0
+  std::vector<GRBConstr> upper_rows; // district_population[t] - U x_jj <= 0
+  std::vector<GRBConstr> lower_rows; // district_population[t] - L x_jj >= 0
 };
 
 //hack
 #define IS_X(i,j) (!p.F0[i][j] && !p.F1[i][j])
 #define X_V(i,j) (p.x[p.h[p.n*i+j]])
 #define X(i,j) (p.F0[i][j]?GRBLinExpr(0.):(p.F1[i][j]?GRBLinExpr(1.):GRBLinExpr(X_V(i,j))))
+#define NR_VAR(p) (static_cast<int>((p).var_i.size()))
 
 struct run_params
 {
@@ -31,6 +40,26 @@ struct run_params
   int k;
   std::string model;
   std::string ralg_hot_start;
+  int ralg_reduce; // keep factor for the reduced dual, 0 is off
+  bool concurrent; // heuristics run next to the Lagrangian
+  int ls_threads; // swaps of LocalSearch evaluated at once, 0 : all cores
+  std::string contiguity_heuristic; // native (region growing, the MIP as fallback) or mip
+  int multilevel; // coarse graph size of the multilevel heuristic, 0 is off
+  int boundary_moves; // annealing moves per vertex after the heuristics and on a time-limited incumbent, 0 is off
+  double ralg_stop_gap; // concurrent : ralg stops when (UB - LB) / UB is below, 0 is off
+  int ralg_stop_stall; // concurrent : ralg stops after this many fixing checks without new fixings, 0 is off
+  int ralg_lazy_rank; // dilations kept aside before updating B, 0 is off
+  bool ralg_float; // single precision dilation matrix
+  std::string ralg_checkpoint; // ralg state file, resumed from when present
+  int ralg_checkpoint_iter;
+  int ralg_spec_width; // trial steps of the ralg line search evaluated concurrently
+  std::string dual_engine; // ralg, volume or bundle
+  std::string population_list; // batch mode : population files solved one after another on the same graph
+  std::string label; // instance name of the output files, the state or (batch mode) the population file, set per instance
+  std::string hot_start_county; // county-level ralg hot start lifted to tracts through hot_start_map
+  std::string hot_start_map; // lines "<tract> <county>"
+  bool reoptimize; // batch mode : re-optimize the model of the previous instance in place when its fixings still hold
+  int hot_start_nearest; // initial columns per vertex of the ralg_hot_start LP, 0 builds the full LP
   FILE* output;
 };
 
@@ -46,4 +75,6 @@ struct pair_hash {
 
 #define MYINFINITY 1e20
 
+const double VarFixingEpsilon = 0.00001; // LB1/LB0 above UB + epsilon fix a variable
+
 #endif
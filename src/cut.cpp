@@ -5,8 +5,11 @@
 #include <chrono>
 #include <unordered_set>
 #include <queue> // priority queue
+#include <algorithm>
+#include <tuple>
 
 const bool do_reverse_nb = true; // controls whether cut C is found near a (true) or near b (false)
+const int heuristic_node_freq = 10; // node relaxations are rounded every heuristic_node_freq nodes
 
 class CutCallback : public HessCallback
 {
@@ -18,25 +21,251 @@ private:
   std::vector<int> cc; // connected component for a vertex
   std::vector<int> dist;
   bool is_lcut;
+  int L;
   int U;
+  // primal heuristic : objective of the variables and its constant (F1), variables with a nonzero UB,
+  // row i fixed to fixed_row[i] (-1 if not)
+  std::vector<double> obj;
+  double obj_con;
+  std::vector<bool> open;
+  std::vector<int> fixed_row;
+  long last_node; // node of the last rounding
 public:
-  CutCallback(hess_params& p, graph *g_, const vector<int>& pop_, bool is_lcut_, int U_) : HessCallback(p, g_, pop_), is_lcut(is_lcut_), U(U_)
+  CutCallback(hess_params& p, graph *g_, const vector<int>& pop_, bool is_lcut_, int L_, int U_, GRBModel* model) : HessCallback(p, g_, pop_),
+    is_lcut(is_lcut_), L(L_), U(U_), last_node(-1)
   {
     visited = new int[n];
     aci = new int[n];
     s.reserve(n);
     cc.resize(n);
     dist.resize(n);
+    read_model(model);
+    fixed_row.assign(n, -1);
+    for (const auto& ij : fixed_one)
+      fixed_row[ij.first] = ij.second;
   }
   virtual ~CutCallback()
   {
     delete[] aci;
     delete[] visited;
   }
+  void refresh(GRBModel* model, int L_, int U_)
+  {
+    L = L_;
+    U = U_;
+    read_model(model);
+  }
 protected:
   void callback();
+private:
+  // objective and variable bounds of the model, read once the fixings of build_lcut and the separators are in
+  void read_model(GRBModel* model)
+  {
+    int nr_var = NR_VAR(p);
+    double* o = model->get(GRB_DoubleAttr_Obj, p.x, nr_var);
+    obj.assign(o, o + nr_var);
+    delete[] o;
+    obj_con = model->get(GRB_DoubleAttr_ObjCon);
+    double* ub = model->get(GRB_DoubleAttr_UB, p.x, nr_var);
+    open.assign(nr_var, false);
+    for (int v = 0; v < nr_var; ++v)
+      open[v] = ub[v] > 0.5;
+    delete[] ub;
+  }
+  // i may be assigned to center c in the model
+  bool allowed(int i, int c)
+  {
+    if (fixed_row[i] >= 0)
+      return fixed_row[i] == c;
+    auto it = p.h.find(p.n * i + c);
+    return !p.F0[i][c] && it != p.h.end() && open[it->second];
+  }
+  // objective of an assignment (vertex -> center) the model allows
+  double assignment_obj(const vector<int>& assign)
+  {
+    double val = obj_con;
+    for (int i = 0; i < n; ++i)
+      if (fixed_row[i] < 0)
+        val += obj[p.h[p.n * i + assign[i]]];
+    return val;
+  }
+  bool repair(vector<int>& assign);
+  bool round_node(vector<int>& assign);
+  void inject(const vector<int>& assign, double incumbent);
 };
 
+// moves the parts of districts not connected to their center to an adjacent district, whole parts at a time,
+// the cheapest district that keeps L/U and the fixings, returns whether all parts found one
+bool CutCallback::repair(vector<int>& assign)
+{
+  using namespace std;
+  vector<long> pop(n, 0L);
+  for (int i = 0; i < n; ++i)
+    pop[assign[i]] += population[i];
+  // rooted : connected to the center inside the district
+  vector<bool> rooted(n, false);
+  for (int b = 0; b < n; ++b)
+    if (assign[b] == b)
+    {
+      s.clear(); s.push_back(b); rooted[b] = true;
+      while (!s.empty())
+      {
+        int cur = s.back(); s.pop_back();
+        for (int nb_cur : g->nb(cur))
+          if (!rooted[nb_cur] && assign[nb_cur] == b)
+          {
+            rooted[nb_cur] = true;
+            s.push_back(nb_cur);
+          }
+      }
+    }
+
+  // a part may only get a neighbor district once another part has moved, so passes until nothing moves
+  vector<int> part;
+  vector<bool> in_part(n, false), tried(n, false);
+  bool progress = true;
+  while (progress)
+  {
+    progress = false;
+    bool left = false;
+    fill(tried.begin(), tried.end(), false);
+    for (int r = 0; r < n; ++r)
+    {
+      if (rooted[r] || tried[r])
+        continue;
+      int b = assign[r];
+      part.clear(); part.push_back(r); in_part[r] = true;
+      long part_pop = 0L;
+      for (size_t t = 0; t < part.size(); ++t)
+      {
+        part_pop += population[part[t]];
+        for (int nb_cur : g->nb(part[t]))
+          if (!in_part[nb_cur] && !rooted[nb_cur] && assign[nb_cur] == b)
+          {
+            in_part[nb_cur] = true;
+            part.push_back(nb_cur);
+          }
+      }
+      int best = -1;
+      double best_cost = MYINFINITY;
+      if (pop[b] - part_pop >= L)
+        for (int u : part)
+          for (int nb_u : g->nb(u))
+          {
+            int d = assign[nb_u];
+            if (!rooted[nb_u] || d == b || d == best || pop[d] + part_pop > U)
+              continue;
+            double cost = 0.;
+            for (int i : part)
+            {
+              if (!allowed(i, d))
+              {
+                cost = MYINFINITY;
+                break;
+              }
+              cost += obj[p.h[p.n * i + d]];
+            }
+            if (cost < best_cost)
+            {
+              best_cost = cost;
+              best = d;
+            }
+          }
+      for (int i : part)
+      {
+        in_part[i] = false;
+        tried[i] = true;
+        if (best >= 0)
+        {
+          assign[i] = best;
+          rooted[i] = true;
+        }
+      }
+      if (best >= 0)
+      {
+        pop[b] -= part_pop;
+        pop[best] += part_pop;
+        progress = true;
+      }
+      else
+        left = true;
+    }
+    if (!left)
+      return true;
+  }
+  return false;
+}
+
+// contiguous districts from the node relaxation in x_val : the k largest x_jj (fixed centers first) are the
+// centers, districts grow from them taking the neighbor of largest x_ic (then the cheapest) under U
+// returns whether every vertex got a district and every district reached L
+bool CutCallback::round_node(vector<int>& assign)
+{
+  using namespace std;
+  double sum = 0.;
+  vector<pair<double, int>> heads;
+  for (int j = 0; j < n; ++j)
+  {
+    sum += x_val[j][j];
+    if (allowed(j, j))
+      heads.push_back(make_pair(fixed_row[j] == j ? 2. : x_val[j][j], j));
+  }
+  int k = static_cast<int>(sum + 0.5);
+  if (k <= 0 || static_cast<int>(heads.size()) < k)
+    return false;
+  partial_sort(heads.begin(), heads.begin() + k, heads.end(), greater<pair<double, int>>());
+
+  // (-x_ic, cost, i, c), the largest x_ic on top
+  typedef tuple<double, double, int, int> entry;
+  priority_queue<entry, vector<entry>, greater<entry>> pq;
+  assign.assign(n, -1);
+  vector<long> pop(n, 0L);
+  auto push_nb = [&](int v, int c) {
+    for (int u : g->nb(v))
+      if (assign[u] < 0 && allowed(u, c))
+        pq.push(make_tuple(-x_val[u][c], fixed_row[u] == c ? 0. : obj[p.h[p.n * u + c]], u, c));
+  };
+  for (int t = 0; t < k; ++t)
+  {
+    int c = heads[t].second;
+    assign[c] = c;
+    pop[c] = population[c];
+  }
+  for (int t = 0; t < k; ++t)
+    push_nb(heads[t].second, heads[t].second);
+  while (!pq.empty())
+  {
+    int i = get<2>(pq.top()), c = get<3>(pq.top());
+    pq.pop();
+    if (assign[i] >= 0 || pop[c] + population[i] > U)
+      continue;
+    assign[i] = c;
+    pop[c] += population[i];
+    push_nb(i, c);
+  }
+  for (int i = 0; i < n; ++i)
+    if (assign[i] < 0)
+      return false;
+  for (int t = 0; t < k; ++t)
+    if (pop[heads[t].second] < L)
+      return false;
+  return true;
+}
+
+// hands a complete assignment cheaper than the incumbent to Gurobi
+void CutCallback::inject(const vector<int>& assign, double incumbent)
+{
+  if (assignment_obj(assign) >= incumbent - 1.e-6)
+    return;
+  int nr_var = NR_VAR(p);
+  std::vector<double> val(nr_var, 0.);
+  for (int i = 0; i < n; ++i)
+    if (fixed_row[i] < 0)
+      val[p.h[p.n * i + assign[i]]] = 1.;
+  setSolution(p.x, val.data(), nr_var);
+  ++numHeuristicSolutions;
+}
+
 void CutCallback::callback()
 {
   using namespace std;
@@ -48,6 +277,7 @@ void CutCallback::callback()
       auto start = chrono::steady_clock::now();
 
       populate_x(); // from HessCallback
+      int numCutsBefore = numLazyCuts;
 
       // try clusterheads
       for (int b = 0; b < n; ++b)
@@ -171,6 +401,32 @@ void CutCallback::callback()
             } // if
         }
       }
+
+      // the rejected incumbent with its detached parts moved to neighbor districts
+      if (numLazyCuts > numCutsBefore)
+      {
+        vector<int> assign(n, -1);
+        for (int i = 0; i < n; ++i)
+          for (int j = 0; j < n && assign[i] < 0; ++j)
+            if (x_val[i][j] > 0.5)
+              assign[i] = j;
+        if (find(assign.begin(), assign.end(), -1) == assign.end() && repair(assign))
+          inject(assign, getDoubleInfo(GRB_CB_MIPSOL_OBJBST));
+      }
+      chrono::duration<double> d = chrono::steady_clock::now() - start;
+      callbackTime += d.count();
+    }
+    else if (where == GRB_CB_MIPNODE && getIntInfo(GRB_CB_MIPNODE_STATUS) == GRB_OPTIMAL)
+    {
+      long node = static_cast<long>(getDoubleInfo(GRB_CB_MIPNODE_NODCNT));
+      if (node == last_node || node % heuristic_node_freq != 0)
+        return;
+      last_node = node;
+      auto start = chrono::steady_clock::now();
+      populate_x(true);
+      vector<int> assign;
+      if (round_node(assign))
+        inject(assign, getDoubleInfo(GRB_CB_MIPNODE_OBJBST));
       chrono::duration<double> d = chrono::steady_clock::now() - start;
       callbackTime += d.count();
     }
@@ -186,20 +442,167 @@ void CutCallback::callback()
   }
 }
 
-HessCallback* build_cut_(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, bool is_lcut, int U)
+// adds a-b separator inequalities x_ab <= sum_{c in C} x_cb for cheap separators C known upfront,
+// so that the callback does not have to discover them one incumbent at a time:
+//   1) C = {c} for an articulation point c separating a from b
+//   2) C = {u, v} for a chain of degree-2 vertices between u and v
+// if every x_cb, c in C, is fixed to zero, x_ab is fixed to zero instead
+// returns the number of inequalities added
+int add_small_separators(GRBModel* model, hess_params& p, graph* g)
+{
+  int n = g->nr_nodes;
+  int numSep = 0, numFixed = 0;
+  // surviving variables x_ab, a != b, by a; rows are only ever written for these
+  vector<vector<int>> vars_of(n);
+  for (int v = 0; v < NR_VAR(p); ++v)
+    if (p.var_i[v] != p.var_j[v] && IS_X(p.var_i[v], p.var_j[v]))
+      vars_of[p.var_i[v]].push_back(v);
+  vector<bool> covered(NR_VAR(p), false); // x_ab already has a separator inequality
+
+  // C = {c} (or the union in C) separates a from b, v is the index of x_ab
+  auto add_sep = [&](int v, const vector<int>& C) {
+    if (covered[v])
+      return;
+    covered[v] = true;
+    int b = p.var_j[v];
+    GRBLinExpr expr = 0;
+    bool all_zero = true;
+    for (int c : C)
+    {
+      if (p.F1[c][b])
+        return; // trivially satisfied
+      if (!p.F0[c][b])
+      {
+        all_zero = false;
+        expr += X_V(c, b);
+      }
+    }
+    if (all_zero)
+    {
+      p.x[v].set(GRB_DoubleAttr_UB, 0.);
+      ++numFixed;
+    }
+    else
+    {
+      model->addConstr(p.x[v] <= expr);
+      ++numSep;
+    }
+  };
+
+  // 1) articulation points, rows x_ab <= x_cb for a on a small side of c (every component of G - c but the largest)
+  vector<bool> is_art;
+  g->articulation_points(is_art);
+
+  struct pocket { int c; int root; int size; }; // component of G - c containing root
+  vector<pocket> pockets;
+  vector<int> lbl(n), s;
+  for (int c = 0; c < n; ++c)
+  {
+    if (!is_art[c])
+      continue;
+    fill(lbl.begin(), lbl.end(), -1);
+    int first = pockets.size(), largest = -1;
+    for (int r = 0; r < n; ++r)
+    {
+      if (r == c || lbl[r] != -1)
+        continue;
+      int size = 0;
+      s.clear(); s.push_back(r); lbl[r] = r;
+      while (!s.empty())
+      {
+        int cur = s.back(); s.pop_back(); ++size;
+        for (int nb_cur : g->nb(cur))
+          if (nb_cur != c && lbl[nb_cur] == -1)
+          {
+            lbl[nb_cur] = r;
+            s.push_back(nb_cur);
+          }
+      }
+      pockets.push_back({ c, r, size });
+      if (largest < 0 || size > pockets[largest].size)
+        largest = pockets.size() - 1;
+    }
+    if (largest >= first)
+      pockets.erase(pockets.begin() + largest);
+  }
+
+  // the innermost separator (smallest side containing a) goes first, others are implied by chaining;
+  // a pocket is labelled again from its root when its turn comes
+  stable_sort(pockets.begin(), pockets.end(), [](const pocket& p1, const pocket& p2) { return p1.size < p2.size; });
+  vector<int> mark(n, -1), members;
+  for (int t = 0; t < static_cast<int>(pockets.size()); ++t)
+  {
+    int c = pockets[t].c;
+    members.clear(); members.push_back(pockets[t].root); mark[pockets[t].root] = t;
+    for (size_t q = 0; q < members.size(); ++q)
+      for (int u : g->nb(members[q]))
+        if (u != c && mark[u] != t)
+        {
+          mark[u] = t;
+          members.push_back(u);
+        }
+    vector<int> C(1, c);
+    for (int a : members)
+      for (int v : vars_of[a])
+        if (p.var_j[v] != c && mark[p.var_j[v]] != t)
+          add_sep(v, C);
+  }
+
+  // 2) maximal chains of degree-2 vertices with distinct ends u and v
+  vector<int> chain_of(n, -1);
+  vector<int> chain;
+  int nr_chains = 0;
+  for (int r = 0; r < n; ++r)
+  {
+    if (g->nb(r).size() != 2 || chain_of[r] != -1)
+      continue;
+    int id = nr_chains++;
+    chain.clear(); chain.push_back(r); chain_of[r] = id;
+    int ends[2];
+    for (int side = 0; side < 2; ++side)
+    {
+      int prev = r, cur = g->nb(r)[side];
+      while (g->nb(cur).size() == 2 && chain_of[cur] == -1)
+      {
+        chain_of[cur] = id;
+        chain.push_back(cur);
+        int next = (g->nb(cur)[0] == prev) ? g->nb(cur)[1] : g->nb(cur)[0];
+        prev = cur; cur = next;
+      }
+      ends[side] = cur;
+    }
+    if (ends[0] == ends[1] || chain_of[ends[0]] == id || chain_of[ends[1]] == id)
+      continue; // pendant cycle (the end is an articulation point) or a cycle component
+    vector<int> C = { ends[0], ends[1] };
+    for (int a : chain)
+      for (int v : vars_of[a])
+      {
+        int b = p.var_j[v];
+        if (chain_of[b] != id && b != ends[0] && b != ends[1])
+          add_sep(v, C);
+      }
+  }
+
+  cout << "Number of small separator inequalities = " << numSep << ", vars fixed = " << numFixed << endl;
+  return numSep;
+}
+
+HessCallback* build_cut_(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, bool is_lcut, int L, int U)
 {
+  add_small_separators(model, p, g);
   model->set(GRB_IntParam_LazyConstraints, 1); // turns off presolve!!!
-  CutCallback* cb = new CutCallback(p, g, population, is_lcut, U);
+  model->update();
+  CutCallback* cb = new CutCallback(p, g, population, is_lcut, L, U, model);
   model->setCallback(cb);
   model->update();
   return cb;
 }
 
-HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population)
+HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int L, int U)
 {
-  return build_cut_(model, p, g, population, false, 0);
+  return build_cut_(model, p, g, population, false, L, U);
 }
-HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U)
+HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int L, int U)
 {
   // fix x_ab=0 if dist_{G,p}(a,b)>U 
   vector<int> dist(g->nr_nodes);
@@ -226,11 +629,11 @@ HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector
     for (int a = 0; a < g->nr_nodes; ++a)
       if (dist[a] > U && IS_X(a, b))
       {
-        model->addConstr(X_V(a, b) == 0);
+        X_V(a, b).set(GRB_DoubleAttr_UB, 0.);
         countFixed++;
       }
   }
   cout << "Number of vars fixed in lcut initialization = " << countFixed << endl;
 
-  return build_cut_(model, p, g, population, true, U);
+  return build_cut_(model, p, g, population, true, L, U);
 }
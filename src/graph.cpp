@@ -156,6 +156,65 @@ bool graph::is_connected()
     return res;
 }
 
+// iterative DFS computing lowpoints (Hopcroft-Tarjan) from root, with label only inside the label class of root
+void graph::articulation_dfs(vector<bool>& is_art, const vector<int>* label, int root, art_scratch& sc)
+{
+    int timer = 0, root_children = 0;
+    vector<int> s(1, root);
+    sc.seen[root] = sc.stamp;
+    sc.disc[root] = sc.low[root] = timer++;
+    sc.parent[root] = -1; sc.it[root] = 0; is_art[root] = false;
+    while (!s.empty())
+    {
+        int v = s.back();
+        if (sc.it[v] < nb(v).size())
+        {
+            int u = nb(v)[sc.it[v]++];
+            if (label && (*label)[u] != (*label)[v])
+                continue;
+            if (sc.seen[u] != sc.stamp)
+            {
+                sc.seen[u] = sc.stamp;
+                sc.parent[u] = v; sc.it[u] = 0; is_art[u] = false;
+                sc.disc[u] = sc.low[u] = timer++;
+                if (v == root)
+                    root_children++;
+                s.push_back(u);
+            }
+            else if (u != sc.parent[v])
+                sc.low[v] = min(sc.low[v], sc.disc[u]);
+        }
+        else
+        {
+            s.pop_back();
+            int pv = sc.parent[v];
+            if (pv != -1)
+            {
+                sc.low[pv] = min(sc.low[pv], sc.low[v]);
+                if (pv != root && sc.low[v] >= sc.disc[pv])
+                    is_art[pv] = true;
+            }
+        }
+    }
+    is_art[root] = root_children > 1;
+}
+
+void graph::articulation_points(vector<bool>& is_art, const vector<int>* label)
+{
+    is_art.assign(nr_nodes, false);
+    art_scratch sc(nr_nodes);
+    sc.stamp = 1;
+    for (int r = 0; r < static_cast<int>(nr_nodes); ++r)
+        if (sc.seen[r] != sc.stamp)
+            articulation_dfs(is_art, label, r, sc);
+}
+
+void graph::articulation_points(vector<bool>& is_art, const vector<int>& label, int root, art_scratch& sc)
+{
+    ++sc.stamp;
+    articulation_dfs(is_art, &label, root, sc);
+}
+
 bool graph::is_edge(uint i, uint j)
 {
     for (uint k : nb_[i])
@@ -8,12 +8,22 @@ typedef unsigned int uint;
 
 using namespace std;
 
+// scratch of graph::articulation_points for repeated calls, n-sized, seen[v] == stamp marks the visited vertices
+struct art_scratch
+{
+    std::vector<int> disc, low, parent, seen;
+    std::vector<uint> it;
+    int stamp;
+    art_scratch(uint n) : disc(n), low(n), parent(n), seen(n, 0), it(n), stamp(0) {}
+};
+
 class graph
 {
 private:
     std::vector<std::vector<int> > nb_;
     bool is_edge(uint i, uint j);
     int k;
+    void articulation_dfs(std::vector<bool>& is_art, const std::vector<int>* label, int root, art_scratch& sc);
 public:
     uint nr_nodes;
     graph(uint n);
@@ -22,6 +32,10 @@ public:
     void remove_edge(uint i, uint j);
     std::vector<int>& nb(uint i) { return nb_[i]; }
     bool is_connected(); // TODO const;
+    // is_art[v] iff removing v disconnects its component, with label only edges inside a label class count
+    void articulation_points(std::vector<bool>& is_art, const std::vector<int>* label = nullptr);
+    // only the label class of root, reached from root, is scanned and only its entries of is_art are written
+    void articulation_points(std::vector<bool>& is_art, const std::vector<int>& label, int root, art_scratch& sc);
 
     // works as far as no pointers are members
     graph* duplicate() const { return new graph(*this); }
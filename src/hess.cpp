@@ -3,7 +3,12 @@
 #include <vector>
 #include <algorithm>
 #include <unordered_set>
+#include <unordered_map>
 #include <string>
+#include <thread>
+#include <memory>
+#include <exception>
+#include <cstdint>
 #include "graph.h"
 #include "gurobi_c++.h"
 #include "models.h"
@@ -11,6 +16,14 @@
 
 using namespace std;
 
+// register x_ij as the next variable of p.x
+static inline void hash_var(hess_params& p, int i, int j)
+{
+  p.h[p.n*i + j] = NR_VAR(p); //FIXME implicit reuse of the map (i,j) -> n*i+j
+  p.var_i.push_back(i);
+  p.var_j.push_back(j);
+}
+
 double get_objective_coefficient(const vector<vector<int>>& dist, const vector<int>& population, int i, int j)
 {
   return (static_cast<double>(dist[i][j]) / 1000.) * (static_cast<double>(dist[i][j]) / 1000.) * static_cast<double>(population[i]);
@@ -18,6 +31,8 @@ double get_objective_coefficient(const vector<vector<int>>& dist, const vector<i
 
 // adds hess model constraints and the objective function to model using graph "g", distance data "dist", population data "pop"
 // returns "x" variables in the Hess model
+// only surviving centers (F0[j][j] false) and their unfixed rows are enumerated, x_ij for a center j
+// that was fixed out is implicitly fixed to zero, so the model size follows the number of unfixed variables
 hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, cvv& F0, cvv& F1)
 {
   // create GUROBI Hess model
@@ -31,67 +46,108 @@ hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >&
   for(int i = 0; i < n; ++i)
     p.infty += population[i];
 
+  // surviving centers
+  vector<int> centers;
+  for (int j = 0; j < n; ++j)
+    if (!F0[j][j])
+      centers.push_back(j);
+    else
+      for (int i = 0; i < n; ++i)
+        p.F0[i][j] = true;
+  int c = centers.size();
 
-  // hash variables
-  int cur = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      if (!F0[i][j] && !F1[i][j])
-        p.h[n*i + j] = cur++; //FIXME implicit reuse of the map (i,j) -> n*i+j
+  // CSR by center : rows of center centers[t] are col_rows[col_start[t]..col_start[t+1])
+  // variables are hashed in the same order, so x of a center is a contiguous block of p.x
+  vector<int> col_start(c + 1, 0);
+  vector<int> col_rows;
+  for (int t = 0; t < c; ++t)
+  {
+    int j = centers[t];
+    for (int i = 0; i < n; ++i)
+      if (!p.F0[i][j])
+      {
+        col_rows.push_back(i);
+        if (!p.F1[i][j])
+          hash_var(p, i, j);
+      }
+    col_start[t + 1] = col_rows.size();
+  }
 
-  printf("Build hess : created %lu variables\n", p.h.size());
-  int nr_var = static_cast<int>(p.h.size());
+  printf("Build hess : created %lu variables over %d centers\n", p.h.size(), c);
+  int nr_var = NR_VAR(p);
 
   // create variables
   p.x = model->addVars(nr_var, GRB_BINARY);
   model->update();
 
   // Set objective: minimize sum d^2_ij*x_ij
-  GRBLinExpr expr = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      expr += w[i][j] * X(i, j);
-
-  model->setObjective(expr, GRB_MINIMIZE);
-
-  // add constraints (b)
+  set_hess_obj(model, p, w);
+  double obj_const = 0.;
+  for (int t = 0; t < c; ++t)
+    for (int r = col_start[t]; r < col_start[t + 1]; ++r)
+      if (p.F1[col_rows[r]][centers[t]])
+        obj_const += w[col_rows[r]][centers[t]];
+  if (obj_const != 0.)
+    model->set(GRB_DoubleAttr_ObjCon, obj_const);
+
+  // add constraints (b), rows are collected from the CSR by center
+  vector<vector<GRBVar>> row_vars(n);
+  vector<int> row_ones(n, 0);
+  for (int v = 0; v < nr_var; ++v)
+    row_vars[p.var_i[v]].push_back(p.x[v]);
+  for (int t = 0; t < c; ++t)
+    for (int r = col_start[t]; r < col_start[t + 1]; ++r)
+      if (p.F1[col_rows[r]][centers[t]])
+        row_ones[col_rows[r]]++;
+  vector<double> ones(n, 1.);
   for (int i = 0; i < n; ++i)
   {
+    if (row_vars[i].empty() && row_ones[i] == 1)
+      continue; // x_ij = 1 is fixed
     GRBLinExpr constr = 0;
-    for (int j = 0; j < n; ++j)
-      constr += X(i, j);
-    model->addConstr(constr == 1);
+    constr.addTerms(ones.data(), row_vars[i].data(), row_vars[i].size());
+    model->addConstr(constr == 1 - row_ones[i]);
   }
+  row_vars.clear(); row_vars.shrink_to_fit();
 
   // add constraint (c)
-  expr = 0;
-  for (int j = 0; j < n; ++j)
+  GRBLinExpr expr = 0;
+  for (int j : centers)
     expr += X(j, j);
   model->addConstr(expr == k);
 
   // add aux constraint for (d) to reduce nonzeros number
-  GRBVar* district_population = model->addVars(n, GRB_CONTINUOUS);
+  GRBVar* district_population = model->addVars(c, GRB_CONTINUOUS);
   model->update();
-  for (int j = 0; j < n; ++j)
+  p.district_population = district_population;
+  p.pop_center = centers;
+  for (int t = 0; t < c; ++t)
   {
+    int j = centers[t];
     GRBLinExpr constr = 0;
-    for (int i = 0; i < n; ++i)
-      constr += population[i] * X(i, j);
-    model->addConstr(constr - district_population[j] == 0);
+    for (int r = col_start[t]; r < col_start[t + 1]; ++r)
+      constr += population[col_rows[r]] * X(col_rows[r], j);
+    p.pop_rows.push_back(model->addConstr(constr - district_population[t] == 0));
   }
 
   // add constraint (d)
-  for (int j = 0; j < n; ++j)
+  for (int t = 0; t < c; ++t)
   {
-    model->addConstr(district_population[j] - U * X(j, j) <= 0); // U
-    model->addConstr(district_population[j] - L * X(j, j) >= 0); // L
+    int j = centers[t];
+    p.upper_rows.push_back(model->addConstr(district_population[t] - U * X(j, j) <= 0)); // U
+    p.lower_rows.push_back(model->addConstr(district_population[t] - L * X(j, j) >= 0)); // L
   }
 
-  // add contraints (e)
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      if (i != j && !F0[i][j])
-        model->addConstr(X(i, j) <= X(j, j));
+  // add contraints (e), they vanish for centers fixed to one
+  for (int t = 0; t < c; ++t)
+  {
+    int j = centers[t];
+    if (p.F1[j][j])
+      continue;
+    for (int r = col_start[t]; r < col_start[t + 1]; ++r)
+      if (col_rows[r] != j)
+        model->addConstr(X(col_rows[r], j) <= X_V(j, j));
+  }
 
   model->update();
 
@@ -100,17 +156,72 @@ hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >&
   return p;
 }
 
+void update_hess_population(GRBModel* model, hess_params& p, const vector<vector<double> >& w, const vector<int>& population, int L, int U)
+{
+  int n = p.n;
+  int c = p.pop_center.size();
+  int nr_var = NR_VAR(p);
+  vector<int> slot(n, -1); // district_population index of center j
+  for (int t = 0; t < c; ++t)
+    slot[p.pop_center[t]] = t;
+
+  // population coefficients, x_ij fixed to one are constants on the right-hand side
+  vector<GRBConstr> rows;
+  vector<GRBVar> vars;
+  vector<double> vals;
+  for (int v = 0; v < nr_var; ++v)
+  {
+    int t = slot[p.var_j[v]];
+    if (t < 0)
+      continue;
+    rows.push_back(p.pop_rows[t]);
+    vars.push_back(p.x[v]);
+    vals.push_back(population[p.var_i[v]]);
+  }
+  vector<double> rhs(c, 0.), rhs_upper(c, 0.), rhs_lower(c, 0.);
+  double obj_const = 0.;
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      if (p.F1[i][j])
+      {
+        obj_const += w[i][j];
+        if (slot[j] >= 0)
+          rhs[slot[j]] -= population[i];
+      }
+
+  // L and U are coefficients of x_jj, or right-hand sides if the center is fixed
+  for (int t = 0; t < c; ++t)
+  {
+    int j = p.pop_center[t];
+    if (p.F1[j][j])
+    {
+      rhs_upper[t] = U;
+      rhs_lower[t] = L;
+      continue;
+    }
+    rows.push_back(p.upper_rows[t]); vars.push_back(X_V(j, j)); vals.push_back(-U);
+    rows.push_back(p.lower_rows[t]); vars.push_back(X_V(j, j)); vals.push_back(-L);
+  }
+  model->chgCoeffs(rows.data(), vars.data(), vals.data(), rows.size());
+  model->set(GRB_DoubleAttr_RHS, p.pop_rows.data(), rhs.data(), c);
+  model->set(GRB_DoubleAttr_RHS, p.upper_rows.data(), rhs_upper.data(), c);
+  model->set(GRB_DoubleAttr_RHS, p.lower_rows.data(), rhs_lower.data(), c);
+
+  set_hess_obj(model, p, w);
+  model->set(GRB_DoubleAttr_ObjCon, obj_const);
+  model->update();
+}
+
 // populate F0 and F1 depending on current centers
 void populate_hess_params(hess_params& p, graph* g, const vector<int>& centers)
 {
   int n = g->nr_nodes; p.n = n;
-  int cur = 0;
-  p.h.clear();
+  p.h.clear(); p.var_i.clear(); p.var_j.clear();
 
   //define x_ij for every for every j \in centers
   for (int j : centers)
     for (int i = 0; i < n; ++i)
-      p.h[n*i + j] = cur++;
+      hash_var(p, i, j);
 
   // clear F0 and F1
   p.F0.resize(n); p.F1.resize(n);
@@ -134,6 +245,63 @@ void populate_hess_params(hess_params& p, graph* g, const vector<int>& centers)
         p.F0[i][j] = true; // other centers as well as corresponding i fixed to 0
 }
 
+// batch attribute access : one API call over all surviving variables instead of one per X_V(i,j)
+void set_hess_start(GRBModel* model, const hess_params& p, const vector<int>& assignment)
+{
+  int nr_var = NR_VAR(p);
+  vector<double> start(nr_var);
+  for (int v = 0; v < nr_var; ++v)
+  {
+    int j = assignment[p.var_i[v]];
+    start[v] = (j < 0) ? GRB_UNDEFINED : (j == p.var_j[v] ? 1. : 0.);
+  }
+  model->set(GRB_DoubleAttr_Start, p.x, start.data(), nr_var);
+}
+
+void set_center_priority(GRBModel* model, const hess_params& p, int priority)
+{
+  int nr_var = NR_VAR(p);
+  vector<int> prio(nr_var, 0);
+  for (int v = 0; v < nr_var; ++v)
+    if (p.var_i[v] == p.var_j[v])
+      prio[v] = priority;
+  model->set(GRB_IntAttr_BranchPriority, p.x, prio.data(), nr_var);
+}
+
+void set_hess_obj(GRBModel* model, const hess_params& p, const vector<vector<double> >& w)
+{
+  int nr_var = NR_VAR(p);
+  vector<double> obj(nr_var);
+  for (int v = 0; v < nr_var; ++v)
+    obj[v] = w[p.var_i[v]][p.var_j[v]];
+  model->set(GRB_DoubleAttr_Obj, p.x, obj.data(), nr_var);
+}
+
+void values_to_assignment(const hess_params& p, const double* x, vector<int>& assignment)
+{
+  int nr_var = NR_VAR(p);
+  assignment.assign(p.n, -1);
+  for (int v = 0; v < nr_var; ++v)
+    if (x[v] > 0.5)
+      assignment[p.var_i[v]] = p.var_j[v];
+  // rows without a variable at one must be fixed to one somewhere
+  for (int i = 0; i < p.n; ++i)
+    if (assignment[i] < 0)
+      for (int j = 0; j < p.n; ++j)
+        if (p.F1[i][j])
+        {
+          assignment[i] = j;
+          break;
+        }
+}
+
+void get_hess_assignment(GRBModel* model, const hess_params& p, vector<int>& assignment)
+{
+  double* x = model->get(GRB_DoubleAttr_X, p.x, NR_VAR(p));
+  values_to_assignment(p, x, assignment);
+  delete[] x;
+}
+
 #define ENSURE(i,j) {if(p.h.count(p.n*i+j)==0){fprintf(stderr,"ensure failed at line %d for i = %d, j = %d\n", __LINE__, i, j);exit(1);}}
 
 // adds hess model constraints and the objective function to model using graph "g", distance data "dist", population data "pop"
@@ -154,12 +322,7 @@ hess_params build_hess_restricted(GRBModel* model, graph* g, const vector<vector
   model->update();
 
   // recompute objective
-  for (int i = 0; i < n; ++i)
-    for (int j : centers)
-    {
-      ENSURE(i, j);
-      X_V(i, j).set(GRB_DoubleAttr_Obj, w[i][j]);
-    }
+  set_hess_obj(model, p, w);
 
   // add constraints (1b)
   for (int i = 0; i < n; ++i)
@@ -266,24 +429,20 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
         else if (arg_model == "mcf")
             build_mcf(&model, p, g);
         else if (arg_model == "cut")
-            cb = build_cut(&model, p, g, population);
+            cb = build_cut(&model, p, g, population, L, U);
         else if (arg_model == "lcut")
-            cb = build_lcut(&model, p, g, population, U);
+            cb = build_lcut(&model, p, g, population, L, U);
         else {
             fprintf(stderr, "ERROR: Unknown contiguity model : %s\n", arg_model.c_str());
             exit(1);
         }
 
         // give a partial warm start where each vertex subset J is assigned to center j
+        vector<int> partial(g->nr_nodes, -1);
         for (int v = 0; v < J.size(); ++v)
-        {
-            int j = centers[v];
-            for (int u = 0; u < J[v].size(); ++u)
-            {
-                int i = J[v][u];
-                X_V(i, j).set(GRB_DoubleAttr_Start, 1);
-            }
-        }
+            for (int i : J[v])
+                partial[i] = centers[v];
+        set_hess_start(&model, p, partial);
 
         // fix centers
         for (int i = 0; i < k; ++i)
@@ -316,12 +475,11 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
                 cout << centers[i] << " ";
             cout << endl;
 
+            vector<int> assignment;
+            get_hess_assignment(&model, p, assignment);
             for (int i = 0; i < g->nr_nodes; ++i)
-                for (int j = 0; j < g->nr_nodes; ++j)
-                    if (p.F0[i][j])
-                        continue;
-                    else if (p.F1[i][j] || X_V(i, j).get(GRB_DoubleAttr_X) > 0.5)
-                        heuristicSolution[i] = j;
+                if (assignment[i] >= 0)
+                    heuristicSolution[i] = assignment[i];
         }
     }
     catch (GRBException e) {
@@ -345,7 +503,8 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
     return;
 }
 
-vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, double &UB, int maxIterations, bool do_cuts)
+vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, double &UB, int maxIterations, bool do_cuts,
+  const function<void(double)>& publish, const function<bool(vector<int>&)>& seed)
 {
   vector<int> heuristicSolution(g->nr_nodes, -1);
 
@@ -369,10 +528,16 @@ vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vect
 
     for (int iter = 0; iter < maxIterations; ++iter)
     {
-      // select k centers at random
+      // select k centers at random, or the ones given by seed (e.g. the Lagrangian centers)
       random_shuffle(allNodes.begin(), allNodes.end()); //FIXME O(n) instead of O(k)
       for (int i = 0; i < k; ++i)
         centers[i] = allNodes[i];
+      vector<int> seeded;
+      if (seed && seed(seeded) && static_cast<int>(seeded.size()) == k)
+      {
+        centers = seeded;
+        cout << "  iteration " << iter << " of HessHeuristic starts from seeded centers" << endl;
+      }
 
       double iterUB = MYINFINITY; // the best UB found in this iteration (iter)
       double oldIterUB;     // the UB found in the previous iteration
@@ -393,15 +558,10 @@ vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vect
         {
           if (cb)
             delete cb;
-          build_cut(&model, p, g, population); //FIXME do pointers instead? worth it? prob no
+          build_cut(&model, p, g, population, L, U); //FIXME do pointers instead? worth it? prob no
         }
         model.reset(); // should be done in any case for predicted behavior
-        for (int i = 0; i < g->nr_nodes; ++i)
-          for (int j : centers)
-          {
-            ENSURE(i, j);
-            X_V(i, j).set(GRB_DoubleAttr_Obj, w[i][j]);
-          }
+        set_hess_obj(&model, p, w);
 
         GRBLinExpr numCenters = 0;
         for (int j : centers)
@@ -426,13 +586,14 @@ vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vect
 
         if (iterUB < oldIterUB) // objective value strictly improved, so we need to update incumbent for this iteration
         {
+          vector<int> assignment;
+          get_hess_assignment(&model, p, assignment);
           for (int j_i = 0; j_i < k; ++j_i)  // find all nodes assigned to the j-th center.
           {
             vector<int> district;
             for (int i = 0; i < g->nr_nodes; ++i)
             {
-              ENSURE(i, centers[j_i]);
-              if (X_V(i, centers[j_i]).get(GRB_DoubleAttr_X) > 0.5) //FIXME cerr if not IS_X
+              if (assignment[i] == centers[j_i])
               {
                 district.push_back(i);
                 iterHeuristicSolution[i] = centers[j_i]; // update this iteration's incumbent
@@ -479,6 +640,8 @@ vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vect
       {
         UB = iterUB;
         heuristicSolution = iterHeuristicSolution;
+        if (publish)
+          publish(UB);
       }
       cout << "In iteration " << iter << " of HessHeuristic, objective value of incumbent is = " << UB << endl;
     }
@@ -504,8 +667,27 @@ vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vect
   return heuristicSolution;
 }
 
+// restricted model of LocalSearch, one per worker thread
+struct ls_model
+{
+  GRBEnv env;
+  GRBModel model;
+  hess_params p;
+  vector<double> col;
+  ls_model() : model(env) {}
+};
+
+// Zobrist key of vertex v, the key of a center set is the XOR of its vertex keys
+static uint64_t zobrist_key(int v)
+{
+  uint64_t z = static_cast<uint64_t>(v) + 0x9e3779b97f4a7c15ULL; // splitmix64
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
 bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, vector<int>&heuristicSolution, double &UB)
+  int L, int U, int k, vector<int>&heuristicSolution, double &UB, const function<void(double)>& publish, int nr_threads)
 {
     cout << endl << "Beginning LOCAL SEARCH with UB = " << UB << "\n\n";
 
@@ -515,19 +697,6 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
       return false;
     }
 
-    // hash routines
-    unordered_set<string> htbl;
-    auto centers_to_string = [](const vector<int>& centers) -> string {
-      vector<int> sorted_centers(centers);
-      sort(sorted_centers.begin(), sorted_centers.end());
-      string ret;
-      for(int c : sorted_centers)
-      {
-        ret += to_string(c) + "_";
-      }
-      return ret;
-    };
-
     // initialize the centers from heuristicSolution
     vector<int> centers(k, -1);
     int pos = 0;
@@ -546,17 +715,178 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
       return false;
     }
 
+    // center sets already tried
+    unordered_set<uint64_t> htbl;
+    uint64_t centers_key = 0;
+    for (int j : centers)
+      centers_key ^= zobrist_key(j);
+
+    // uncapacitated assignment bound of a swap : every i to its closest center, O(n) from the two closest
+    // centers of every i under the current centers, a swap with bound >= UB cannot improve and is not solved
+    int n = g->nr_nodes;
+    vector<double> best1(n), best2(n);
+    vector<int> best1_center(n);
+    auto update_closest = [&]() {
+      for (int i = 0; i < n; ++i)
+      {
+        best1[i] = best2[i] = MYINFINITY;
+        best1_center[i] = -1;
+        for (int j : centers)
+          if (w[i][j] < best1[i])
+          {
+            best2[i] = best1[i];
+            best1[i] = w[i][j];
+            best1_center[i] = j;
+          }
+          else if (w[i][j] < best2[i])
+            best2[i] = w[i][j];
+      }
+    };
+    auto swap_bound = [&](int v, int u) {
+      double bound = 0.;
+      for (int i = 0; i < n; ++i)
+        bound += mymin(best1_center[i] == v ? best2[i] : best1[i], w[i][u]);
+      return bound;
+    };
+    update_closest();
+    long nr_solved = 0, nr_pruned = 0, nr_seen = 0;
+
+    if (nr_threads <= 0)
+      nr_threads = mymax(1, static_cast<int>(thread::hardware_concurrency()));
+    int grb_threads = mymax(1, static_cast<int>(thread::hardware_concurrency()) / nr_threads);
+    if (nr_threads > 1)
+      printf("Local search evaluates %d swaps at once, %d Gurobi threads each\n", nr_threads, grb_threads);
+
     try {
-      GRBEnv env = GRBEnv();
-      GRBModel model = GRBModel(env);
-      hess_params p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
-      for (int j : centers)
+      // every worker owns a copy of the restricted model, kept in sync on every accepted swap
+      vector<unique_ptr<ls_model>> workers;
+      for (int t = 0; t < nr_threads; ++t)
       {
-        ENSURE(j, j);
-        X_V(j, j).set(GRB_DoubleAttr_LB, 1); // assign the centers to themselves.
+        workers.emplace_back(new ls_model());
+        GRBModel& model = workers[t]->model;
+        hess_params& p = workers[t]->p;
+        p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
+        for (int j : centers)
+        {
+          ENSURE(j, j);
+          X_V(j, j).set(GRB_DoubleAttr_LB, 1); // assign the centers to themselves.
+        }
+        model.set(GRB_DoubleParam_TimeLimit, 60.);
+        model.set(GRB_IntParam_OutputFlag, 0);
+        if (nr_threads > 1)
+          model.set(GRB_IntParam_Threads, grb_threads);
+        workers[t]->col.resize(g->nr_nodes);
       }
-      model.set(GRB_DoubleParam_TimeLimit, 60.);
-      model.set(GRB_IntParam_OutputFlag, 0);
+      // the variables x_{.,slot} of a center slot are contiguous in p.x (see populate_hess_params)
+      auto set_column_obj = [&](ls_model& m, int slot, int center) {
+        hess_params& p = m.p;
+        for (int i = 0; i < g->nr_nodes; ++i)
+          m.col[i] = w[i][center];
+        ENSURE(0, slot);
+        m.model.set(GRB_DoubleAttr_Obj, &X_V(0, slot), m.col.data(), g->nr_nodes);
+      };
+      // slot v holds center u (u == v reverts)
+      auto set_swap = [&](ls_model& m, int v, int u) {
+        hess_params& p = m.p;
+        set_column_obj(m, v, u);
+        if (u == v)
+          return;
+        X_V(v,v).set(GRB_DoubleAttr_LB, 0);
+        X_V(u,v).set(GRB_DoubleAttr_LB, 1);
+      };
+      auto unset_swap = [&](ls_model& m, int v, int u) {
+        hess_params& p = m.p;
+        set_column_obj(m, v, v);
+        X_V(v,v).set(GRB_DoubleAttr_LB, 1);
+        X_V(u,v).set(GRB_DoubleAttr_LB, 0);
+      };
+      // objective of the restricted model with v swapped for u, MYINFINITY if no better than cutoff
+      auto evaluate = [&](ls_model& m, int v, int u, double cutoff) -> double {
+        m.model.reset();
+        m.model.set(GRB_DoubleParam_Cutoff, cutoff);
+        // update cost coefficients, as if we had centers[p] = u
+        set_swap(m, v, u);
+        m.model.optimize();
+        double val = MYINFINITY;
+        // update incumbent (if needed) if solved or timed out
+        if (m.model.get(GRB_IntAttr_Status) == 2 || m.model.get(GRB_IntAttr_Status) == 9) // model was solved to optimality (subject to tolerances), so update UB.
+          val = m.model.get(GRB_DoubleAttr_ObjVal);
+        if (val >= cutoff) // revert back
+        {
+          unset_swap(m, v, u);
+          val = MYINFINITY;
+        }
+        return val;
+      };
+
+      // candidate swaps (c_i, u) in the order of the sequential search, evaluated nr_threads at a time across
+      // the centers, the first improving one wins, so the result does not depend on the number of threads
+      vector<pair<int, int>> batch;
+      vector<uint64_t> batch_key;
+      // evaluates the batch and takes its winner, returns whether there was one
+      auto flush = [&]() -> bool {
+        int nr_batch = batch.size();
+        vector<double> val(nr_batch, MYINFINITY);
+        vector<thread> threads;
+        vector<exception_ptr> errors(nr_batch);
+        for (int t = 1; t < nr_batch; ++t)
+          threads.emplace_back([&, t]() {
+            try { val[t] = evaluate(*workers[t], centers[batch[t].first], batch[t].second, UB); }
+            catch (...) { errors[t] = current_exception(); }
+          });
+        val[0] = evaluate(*workers[0], centers[batch[0].first], batch[0].second, UB);
+        for (auto& th : threads)
+          th.join();
+        for (int t = 1; t < nr_batch; ++t)
+          if (errors[t])
+            rethrow_exception(errors[t]);
+        nr_solved += nr_batch;
+
+        int win = -1;
+        for (int t = 0; t < nr_batch && win < 0; ++t)
+        {
+          htbl.insert(batch_key[t]); // candidates after the winner stay unseen, as in the sequential order
+          if (val[t] < UB)
+            win = t;
+        }
+        if (win >= 0)
+        {
+          int w_i = batch[win].first, v = centers[w_i], u = batch[win].second;
+          double newUB = val[win];
+          cout << "found better UB from LS restricted IP = " << newUB;
+          UB = newUB;
+          if (publish)
+            publish(UB);
+          // every worker takes the swap, the winner keeps its solution
+          for (int t = 0; t < nr_batch; ++t)
+            if (t != win && val[t] < MYINFINITY)
+              unset_swap(*workers[t], centers[batch[t].first], batch[t].second);
+          for (int t = 0; t < nr_threads; ++t)
+            if (t != win)
+              set_swap(*workers[t], v, u);
+          // update centers
+          centers[w_i] = u;
+          centers_key ^= zobrist_key(v) ^ zobrist_key(u);
+          update_closest();
+          cout << " with centers : ";
+          for (int i = 0; i < k; ++i)
+            cout << centers[i] << " ";
+          cout << endl;
+          // update hess params
+          for (int t = 0; t < nr_threads; ++t)
+            populate_hess_params(workers[t]->p, g, centers);
+          // update heuristicSolution
+          vector<int> assignment;
+          get_hess_assignment(&workers[win]->model, workers[win]->p, assignment);
+          for (int i = 0; i < g->nr_nodes; ++i)
+            if (assignment[i] >= 0)
+              heuristicSolution[i] = assignment[i];
+        }
+        batch.clear();
+        batch_key.clear();
+        return win >= 0;
+      };
+
       bool improvement;
       do {
         improvement = false;
@@ -564,68 +894,33 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
         {
           int v = centers[c_i];
           cout << "  checking neighbors of node " << v << endl;
-          for (int u : g->nb(v))  // swap v for u?
+          for (int u : g->nb(v)) // swap v for u?
           {
-            if (improvement) break;
-            // cache centers
-            centers[c_i] = u;
-            string centers_str = centers_to_string(centers);
-            centers[c_i] = v;
-            if(htbl.count(centers_str) > 0)
+            uint64_t key = centers_key ^ zobrist_key(v) ^ zobrist_key(u);
+            if (htbl.count(key) > 0 || find(batch_key.begin(), batch_key.end(), key) != batch_key.end())
             {
               printf("Local Search skipping seen centers...\n");
+              nr_seen++;
               continue;
             }
-            htbl.insert(centers_str);
-            model.reset();
-            model.set(GRB_DoubleParam_Cutoff, UB);
-            // update cost coefficients, as if we had centers[p] = u
-            for (int i = 0; i < g->nr_nodes; ++i)
+            // UB only decreases, a pruned center set stays pruned
+            if (swap_bound(v, u) >= UB)
             {
-              ENSURE(i,v);
-              X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][u]);
+              htbl.insert(key);
+              nr_pruned++;
+              continue;
             }
-            X_V(v,v).set(GRB_DoubleAttr_LB, 0);
-            X_V(u,v).set(GRB_DoubleAttr_LB, 1);
-            model.optimize();
-            // revert back
-            for (int i = 0; i < g->nr_nodes; ++i)
-              X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][v]);
-            X_V(v,v).set(GRB_DoubleAttr_LB, 1);
-            X_V(u,v).set(GRB_DoubleAttr_LB, 0);
-            // update incumbent (if needed) if solved or timed out
-            if (model.get(GRB_IntAttr_Status) == 2 || model.get(GRB_IntAttr_Status) == 9) // model was solved to optimality (subject to tolerances), so update UB.
+            batch.push_back(make_pair(c_i, u));
+            batch_key.push_back(key);
+            if (static_cast<int>(batch.size()) == nr_threads && flush())
             {
-              double newUB = model.get(GRB_DoubleAttr_ObjVal);
-              if (newUB < UB)
-              {
-                improvement = true;
-                cout << "found better UB from LS restricted IP = " << newUB;
-                UB = newUB;
-                // update centers, costs, and var fixings
-                centers[c_i] = u;
-                for (int i = 0; i < g->nr_nodes; ++i)
-                  X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][u]);
-                X_V(v,v).set(GRB_DoubleAttr_LB, 0);
-                X_V(u,v).set(GRB_DoubleAttr_LB, 1);
-                cout << " with centers : ";
-                for (int i = 0; i < k; ++i)
-                  cout << centers[i] << " ";
-                cout << endl;
-                // update hess params
-                populate_hess_params(p, g, centers);
-                // update heuristicSolution
-                for (int i = 0; i < g->nr_nodes; ++i)
-                  for (int j = 0; j < k; ++j)
-                  {
-                    ENSURE(i,centers[j]);
-                    if (X_V(i,centers[j]).get(GRB_DoubleAttr_X) > 0.5)
-                      heuristicSolution[i] = centers[j];
-                  }
-              }
+              improvement = true;
+              break;
             }
           }
         }
+        if (!improvement && !batch.empty())
+          improvement = flush();
       } while (improvement);
     }
     catch (GRBException e) {
@@ -641,6 +936,7 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
       cout << "Exception during optimization" << endl;
       return false;
     }
+    printf("Local search : %ld swaps solved, %ld pruned by the assignment bound, %ld seen before\n", nr_solved, nr_pruned, nr_seen);
     cout << "UB at end of local search heuristic = " << UB << endl;
     double obj = 0;
     for (int i = 0; i < g->nr_nodes; ++i)
@@ -659,10 +955,9 @@ hess_params build_hess_special(GRBModel* model, graph* g, const vector<vector<do
   p.F1 = std::vector<std::vector<bool>>(n, std::vector<bool>(n, false));
 
   // do this only for compatibility with typical hess
-  int cur = 0;
   for (int i = 0; i < n; ++i)
     for (int j = 0; j < n; ++j)
-        p.h[n*i + j] = cur++; //FIXME unify ind
+        hash_var(p, i, j);
 
   printf("Build hess : created %lu variables\n", p.h.size());
   int nr_var = static_cast<int>(p.h.size());
@@ -718,3 +1013,166 @@ hess_params build_hess_special(GRBModel* model, graph* g, const vector<vector<do
 
   return p;
 }
+
+double solve_hess_special_cg(GRBEnv& env, graph* g, const vector<vector<int>>& dist, const vector<int>& population, int L, int U, int k, int nearest, vector<double>& pi)
+{
+  // restricted relaxation of build_hess_special : the rows (b), (d) and (c) are complete, the columns
+  // start from the nearest vertices of every i and the rows (e) are added when violated
+  // artificial a_i in (b) and s_j in (d) lower with cost M keep the restricted model feasible
+  int n = g->nr_nodes;
+  GRBModel model = GRBModel(env);
+  double M = 0.;
+  for (int i = 0; i < n; ++i)
+    M = max(M, get_objective_coefficient(dist, population, i, i));
+  M = 10. * (M + 1.);
+
+  vector<GRBVar> art(2*n);
+  vector<GRBConstr> rows(3*n + 1); // (b), (d) lower, (d) upper, (c)
+  for (int i = 0; i < 2*n; ++i)
+    art[i] = model.addVar(0., GRB_INFINITY, M, GRB_CONTINUOUS);
+  model.update();
+  for (int i = 0; i < n; ++i)
+    rows[i] = model.addConstr(GRBLinExpr(art[i]), GRB_EQUAL, 1.);
+  for (int j = 0; j < n; ++j)
+    rows[n + j] = model.addConstr(GRBLinExpr(art[n + j]), GRB_GREATER_EQUAL, 0.);
+  for (int j = 0; j < n; ++j)
+    rows[2*n + j] = model.addConstr(GRBLinExpr(), GRB_LESS_EQUAL, 0.);
+  rows[3*n] = model.addConstr(GRBLinExpr(), GRB_EQUAL, k);
+
+  // columns x_ij, (i, j) -> position in var
+  vector<GRBVar> var;
+  vector<int> var_i, var_j;
+  vector<bool> has_row; // row (e) of x_ij added
+  unordered_map<long long, int> column;
+  auto add_column = [&](int i, int j)
+  {
+    GRBColumn col;
+    col.addTerm(1., rows[i]);
+    col.addTerm(population[i] - (i == j ? L : 0), rows[n + j]);
+    col.addTerm(population[i] - (i == j ? U : 0), rows[2*n + j]);
+    if (i == j)
+      col.addTerm(1., rows[3*n]);
+    column[static_cast<long long>(n) * i + j] = static_cast<int>(var.size());
+    var.push_back(model.addVar(0., GRB_INFINITY, get_objective_coefficient(dist, population, i, j), GRB_CONTINUOUS, col));
+    var_i.push_back(i);
+    var_j.push_back(j);
+    has_row.push_back(false);
+  };
+
+  // x_jj first, so that the center of j is var[j]
+  for (int j = 0; j < n; ++j)
+    add_column(j, j);
+  vector<int> order(n);
+  for (int i = 0; i < n; ++i)
+  {
+    for (int j = 0; j < n; ++j)
+      order[j] = j;
+    int m = min(nearest, n - 1);
+    nth_element(order.begin(), order.begin() + m, order.end(), [&](int a, int b) { return dist[i][a] < dist[i][b]; });
+    for (int t = 0; t <= m; ++t)
+      if (order[t] != i)
+        add_column(i, order[t]);
+  }
+  model.update();
+  model.set(GRB_IntParam_OutputFlag, 0);
+
+  // columns priced in per vertex i and round
+  const int per_row = 5;
+  const double eps = 1.e-6;
+  bool interior = false;
+  int round = 0, nr_rows = 0;
+  while (true)
+  {
+    round++;
+    model.optimize();
+    if (model.get(GRB_IntAttr_Status) != GRB_OPTIMAL)
+      throw "restricted hot start LP is not solved to optimality";
+
+    // rows (e) violated by the restricted solution
+    int added_rows = 0;
+    double* x = model.get(GRB_DoubleAttr_X, var.data(), static_cast<int>(var.size()));
+    for (int v = n; v < static_cast<int>(var.size()); ++v)
+      if (!has_row[v] && x[v] > x[var_j[v]] + eps)
+      {
+        model.addConstr(var[v] <= var[var_j[v]]);
+        has_row[v] = true;
+        added_rows++;
+      }
+    delete[] x;
+    nr_rows += added_rows;
+
+    // pricing : a column out of the model has no row (e), rc = w_ij - pi_i - p_i (mu^L_j + mu^U_j)
+    int added_cols = 0;
+    if (added_rows == 0)
+    {
+      double* y = model.get(GRB_DoubleAttr_Pi, rows.data(), 3*n);
+      vector<pair<double, int>> cand;
+      for (int i = 0; i < n; ++i)
+      {
+        cand.clear();
+        for (int j = 0; j < n; ++j)
+        {
+          double rc = get_objective_coefficient(dist, population, i, j) - y[i] - population[i] * (y[n + j] + y[2*n + j]);
+          if (rc < -eps && column.find(static_cast<long long>(n) * i + j) == column.end())
+            cand.push_back(make_pair(rc, j));
+        }
+        if (static_cast<int>(cand.size()) > per_row)
+        {
+          nth_element(cand.begin(), cand.begin() + per_row, cand.end());
+          cand.resize(per_row);
+        }
+        for (auto& c : cand)
+          add_column(i, c.second);
+        added_cols += static_cast<int>(cand.size());
+      }
+      delete[] y;
+    }
+    printf("Hot start round %d : obj = %.6lf, columns = %lu, rows (e) = %d, added %d columns and %d rows\n",
+      round, model.get(GRB_DoubleAttr_ObjVal), var.size(), nr_rows, added_cols, added_rows);
+
+    if (added_rows > 0 || added_cols > 0)
+    {
+      if (interior)
+      {
+        // back to simplex warm starts until the model is complete again
+        model.set(GRB_IntParam_Method, -1);
+        model.set(GRB_IntParam_Crossover, -1);
+        interior = false;
+      }
+      model.update();
+      continue;
+    }
+
+    // an artificial in the optimum means M is below the dual values
+    double* a = model.get(GRB_DoubleAttr_X, art.data(), 2*n);
+    double a_max = 0.;
+    for (int i = 0; i < 2*n; ++i)
+      a_max = max(a_max, a[i]);
+    delete[] a;
+    if (a_max > eps)
+    {
+      M *= 10.;
+      if (M > 1.e12)
+        throw "hot start LP is infeasible";
+      for (int i = 0; i < 2*n; ++i)
+        art[i].set(GRB_DoubleAttr_Obj, M);
+      continue;
+    }
+
+    // the simplex duals are a vertex, the hot start is taken from the interior point as before
+    if (!interior)
+    {
+      model.set(GRB_IntParam_Method, 2);
+      model.set(GRB_IntParam_Crossover, 0);
+      interior = true;
+      continue;
+    }
+    break;
+  }
+
+  double* y = model.get(GRB_DoubleAttr_Pi, rows.data(), 3*n);
+  pi.assign(y, y + 3*n);
+  delete[] y;
+  printf("Hot start LP : %lu of %lld columns, %d of %lld rows (e)\n", var.size(), static_cast<long long>(n) * n, nr_rows, static_cast<long long>(n) * n);
+  return model.get(GRB_DoubleAttr_ObjVal);
+}
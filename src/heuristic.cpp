@@ -0,0 +1,431 @@
+// native heuristics : region growing from given centers with a repair pass for L/U, boundary-move annealing
+#include <cstdio>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <cmath>
+#include "graph.h"
+#include "models.h"
+
+using namespace std;
+
+const int GrowRounds = 5;           // grow/repair/recenter rounds while the cost improves
+const int RepairMovesPerVertex = 4; // repair gives up after this many moves per vertex
+const unsigned BoundaryMoveSeed = 2020;
+const double BoundaryMoveFinalTemp = 1.e-3; // final / start temperature of the annealing
+const long BoundaryMoveRecenters = 20;      // recentering passes over a run
+
+// population outside [L, U] of a district
+static long violation(long pop, int L, int U)
+{
+  if (pop > U) return pop - U;
+  if (pop < L) return L - pop;
+  return 0;
+}
+
+// multi-source growing : the unassigned vertex closest (in w) to an adjacent center joins it,
+// unless it would push the district over U; the vertices left over join their cheapest neighboring district
+static void grow(graph* g, const vector<vector<double>>& w, const vector<int>& population, int U,
+  const vector<int>& centers, vector<int>& district, vector<long>& pop)
+{
+  int n = g->nr_nodes;
+  int k = centers.size();
+  district.assign(n, -1);
+  pop.assign(k, 0L);
+  typedef tuple<double, int, int> item; // w(i, center), i, district
+  priority_queue<item, vector<item>, greater<item>> pq;
+  auto take = [&](int i, int d) {
+    district[i] = d;
+    pop[d] += population[i];
+    for (int nb_i : g->nb(i))
+      if (district[nb_i] < 0)
+        pq.push(make_tuple(w[nb_i][centers[d]], nb_i, d));
+  };
+  for (int d = 0; d < k; ++d)
+    take(centers[d], d);
+  while (!pq.empty())
+  {
+    int i = get<1>(pq.top()), d = get<2>(pq.top());
+    pq.pop();
+    if (district[i] >= 0 || pop[d] + population[i] > U)
+      continue;
+    take(i, d);
+  }
+
+  // left over : blocked by U everywhere around, admitted without the limit
+  for (int i = 0; i < n; ++i)
+    if (district[i] >= 0)
+      for (int nb_i : g->nb(i))
+        if (district[nb_i] < 0)
+          pq.push(make_tuple(w[nb_i][centers[district[i]]], nb_i, district[i]));
+  while (!pq.empty())
+  {
+    int i = get<1>(pq.top()), d = get<2>(pq.top());
+    pq.pop();
+    if (district[i] < 0)
+      take(i, d);
+  }
+}
+
+// boundary moves until every district is within [L, U]. A vertex may leave its district if it is not the center
+// and not an articulation point of the district. The move that reduces the total violation most (then the
+// cheapest) is taken; if there is none, a chain of moves along adjacent districts carries population from a
+// district above U (or above L) to one below L (or below U), every district on the way gives one vertex
+static bool repair(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U,
+  const vector<int>& centers, vector<int>& district, vector<long>& pop)
+{
+  int n = g->nr_nodes;
+  int k = centers.size();
+  long total = 0;
+  for (int d = 0; d < k; ++d)
+    total += violation(pop[d], L, U);
+  // articulation points of every district, a move recomputes them for the two districts it touches
+  vector<bool> is_art;
+  art_scratch sc(n);
+  g->articulation_points(is_art, &district);
+  // a movable vertex can go from a to b (a * k + b)
+  vector<bool> edge(static_cast<size_t>(k) * k);
+  auto move_vertex = [&](int i, int b) {
+    int a = district[i];
+    total -= violation(pop[a], L, U) + violation(pop[b], L, U);
+    pop[a] -= population[i];
+    pop[b] += population[i];
+    district[i] = b;
+    total += violation(pop[a], L, U) + violation(pop[b], L, U);
+    g->articulation_points(is_art, district, centers[a], sc);
+    g->articulation_points(is_art, district, centers[b], sc);
+  };
+  for (long nr_moves = 0; total > 0 && nr_moves < static_cast<long>(RepairMovesPerVertex) * n; ++nr_moves)
+  {
+    fill(edge.begin(), edge.end(), false);
+    long best_delta = 0;
+    double best_cost = MYINFINITY;
+    int best_i = -1, best_b = -1;
+    for (int i = 0; i < n; ++i)
+    {
+      int a = district[i];
+      if (centers[a] == i || is_art[i])
+        continue;
+      for (int nb_i : g->nb(i))
+      {
+        int b = district[nb_i];
+        if (b == a)
+          continue;
+        double cost = w[i][centers[b]] - w[i][centers[a]];
+        edge[static_cast<size_t>(a) * k + b] = true;
+        long delta = violation(pop[a] - population[i], L, U) + violation(pop[b] + population[i], L, U)
+          - violation(pop[a], L, U) - violation(pop[b], L, U);
+        if (delta < best_delta || (delta == best_delta && delta < 0 && cost < best_cost))
+        {
+          best_delta = delta;
+          best_cost = cost;
+          best_i = i;
+          best_b = b;
+        }
+      }
+    }
+    if (best_i >= 0)
+    {
+      move_vertex(best_i, best_b);
+      continue;
+    }
+
+    // chain : BFS over the districts from the donors to the nearest receiver
+    bool any_over = false, any_under = false;
+    for (int d = 0; d < k; ++d)
+    {
+      any_over = any_over || pop[d] > U;
+      any_under = any_under || pop[d] < L;
+    }
+    vector<int> from(k, -2);
+    queue<int> q;
+    for (int d = 0; d < k; ++d)
+      if (any_over ? pop[d] > U : pop[d] > L)
+      {
+        from[d] = -1;
+        q.push(d);
+      }
+    int target = -1;
+    while (!q.empty() && target < 0)
+    {
+      int a = q.front(); q.pop();
+      for (int b = 0; b < k && target < 0; ++b)
+        if (from[b] == -2 && edge[static_cast<size_t>(a) * k + b])
+        {
+          from[b] = a;
+          if (any_under ? pop[b] < L : pop[b] < U)
+            target = b;
+          else
+            q.push(b);
+        }
+    }
+    if (target < 0)
+      break;
+    // moves from the end of the chain, a district gives its vertex before it receives one,
+    // the cheapest vertex that touches what is left of the receiver goes
+    vector<pair<int, int>> done; // vertex, district it came from
+    long total_before = total;
+    bool ok = true;
+    for (int b = target; from[b] >= 0 && ok; b = from[b])
+    {
+      int a = from[b];
+      int i = -1;
+      double i_cost = MYINFINITY;
+      for (int v = 0; v < n; ++v)
+      {
+        if (district[v] != a || centers[a] == v || is_art[v])
+          continue;
+        bool touches = false;
+        for (int nb_v : g->nb(v))
+          touches = touches || district[nb_v] == b;
+        double cost = w[v][centers[b]] - w[v][centers[a]];
+        if (touches && (i < 0 || cost < i_cost))
+        {
+          i = v;
+          i_cost = cost;
+        }
+      }
+      if (i < 0)
+      {
+        ok = false;
+        break;
+      }
+      done.push_back(make_pair(i, a));
+      move_vertex(i, b);
+    }
+    if (!ok || total >= total_before)
+    {
+      for (auto it = done.rbegin(); it != done.rend(); ++it)
+        move_vertex(it->first, it->second);
+      break;
+    }
+  }
+  return total == 0;
+}
+
+bool NativeContiguityHeuristic(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U,
+  vector<int>& heuristicSolution, double& UB)
+{
+  int n = g->nr_nodes;
+  vector<int> centers;
+  for (int i = 0; i < n; ++i)
+    if (heuristicSolution[i] == i)
+      centers.push_back(i);
+  if (centers.empty())
+    return false;
+  int k = centers.size();
+
+  bool found = false;
+  vector<int> district;
+  vector<long> pop;
+  for (int round = 0; round < GrowRounds; ++round)
+  {
+    grow(g, w, population, U, centers, district, pop);
+    if (!repair(g, w, population, L, U, centers, district, pop))
+    {
+      printf("Native contiguity heuristic : round %d, repair failed\n", round);
+      break;
+    }
+
+    // recenter : the best center of every (connected) district
+    vector<vector<int>> members(k);
+    for (int i = 0; i < n; ++i)
+      members[district[i]].push_back(i);
+    double cost = 0.;
+    bool changed = false;
+    for (int d = 0; d < k; ++d)
+    {
+      int best = centers[d];
+      double best_cost = MYINFINITY;
+      for (int c : members[d])
+      {
+        double c_cost = 0.;
+        for (int i : members[d])
+          c_cost += w[i][c];
+        if (c_cost < best_cost)
+        {
+          best_cost = c_cost;
+          best = c;
+        }
+      }
+      changed = changed || best != centers[d];
+      centers[d] = best;
+      cost += best_cost;
+    }
+    printf("Native contiguity heuristic : round %d, cost %.2lf\n", round, cost);
+    if (cost >= UB)
+      break;
+    UB = cost;
+    for (int i = 0; i < n; ++i)
+      heuristicSolution[i] = centers[district[i]];
+    found = true;
+    if (!changed)
+      break;
+  }
+  return found;
+}
+
+bool BoundaryMoveSearch(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U,
+  bool contiguous, long nr_moves, vector<int>& solution, double& UB)
+{
+  int n = g->nr_nodes;
+  if (nr_moves <= 0 || static_cast<int>(solution.size()) < n)
+    return false;
+  // districts are numbered, center[d] is the center of district d
+  vector<int> center, dist_of(n, -1), index(n, -1);
+  for (int i = 0; i < n; ++i)
+    if (solution[i] == i)
+    {
+      index[i] = center.size();
+      center.push_back(i);
+    }
+  int k = center.size();
+  vector<long> pop(k, 0L);
+  double cost = 0.;
+  for (int i = 0; i < n; ++i)
+  {
+    if (solution[i] < 0 || index[solution[i]] < 0)
+      return false;
+    dist_of[i] = index[solution[i]];
+    pop[dist_of[i]] += population[i];
+    cost += w[i][solution[i]];
+  }
+  for (int d = 0; d < k; ++d)
+    if (pop[d] < L || pop[d] > U)
+    {
+      printf("Boundary moves : the start is out of [L, U], skipped\n");
+      return false;
+    }
+
+  vector<bool> is_art(n, false);
+  art_scratch sc(n);
+  if (contiguous)
+    g->articulation_points(is_art, &dist_of);
+
+  // simulated annealing, the start temperature accepts an average uphill move with probability 1/2
+  mt19937 rng(BoundaryMoveSeed);
+  uniform_int_distribution<int> pick(0, n - 1);
+  uniform_real_distribution<double> coin(0., 1.);
+  double up_sum = 0.;
+  int nr_up = 0;
+  for (int t = 0; t < 1000; ++t)
+  {
+    int i = pick(rng);
+    for (int j : g->nb(i))
+      if (dist_of[j] != dist_of[i])
+      {
+        double delta = w[i][center[dist_of[j]]] - w[i][center[dist_of[i]]];
+        if (delta > 0.)
+        {
+          up_sum += delta;
+          nr_up++;
+        }
+      }
+  }
+  double temp = (nr_up > 0) ? up_sum / nr_up / log(2.) : 0.;
+  double cooling = pow(BoundaryMoveFinalTemp, 1. / nr_moves);
+
+  double best = cost;
+  vector<int> best_dist = dist_of, best_center = center;
+  long nr_accepted = 0;
+  long recenter_every = mymax(1L, nr_moves / BoundaryMoveRecenters);
+  // the best center of every district of dist_d, center_d is replaced, returns the cost ; it costs sum |d|^2
+  auto recenter = [&](const vector<int>& dist_d, vector<int>& center_d) {
+    vector<vector<int>> members(k);
+    for (int v = 0; v < n; ++v)
+      members[dist_d[v]].push_back(v);
+    double total = 0.;
+    for (int d = 0; d < k; ++d)
+    {
+      double best_cost = MYINFINITY;
+      for (int c : members[d])
+      {
+        double c_cost = 0.;
+        for (int v : members[d])
+          c_cost += w[v][c];
+        if (c_cost < best_cost)
+        {
+          best_cost = c_cost;
+          center_d[d] = c;
+        }
+      }
+      total += best_cost;
+    }
+    return total;
+  };
+  auto keep_best = [&]() {
+    if (cost < best - 1.e-9 * myabs(best))
+    {
+      best = cost;
+      best_dist = dist_of;
+      best_center = center;
+    }
+  };
+  for (long t = 1; t <= nr_moves; ++t, temp *= cooling)
+  {
+    // periodic recenter, whether the moves in between were accepted or not
+    if (t % recenter_every == 0)
+    {
+      cost = recenter(dist_of, center);
+      keep_best();
+    }
+    int i = pick(rng);
+    int a = dist_of[i];
+    const vector<int>& nb = g->nb(i);
+    if (center[a] == i || nb.empty())
+      continue;
+    int j = nb[rng() % nb.size()];
+    int b = dist_of[j];
+    if (b == a || (contiguous && is_art[i]))
+      continue;
+    double delta = w[i][center[b]] - w[i][center[a]];
+    if (pop[a] - population[i] < L || pop[b] + population[i] > U)
+    {
+      // swap with j : i goes to b, j to a, both keep a neighbor in their new district
+      if (center[b] == j || (contiguous && is_art[j]))
+        continue;
+      long pop_a = pop[a] - population[i] + population[j], pop_b = pop[b] + population[i] - population[j];
+      if (pop_a < L || pop_a > U || pop_b < L || pop_b > U)
+        continue;
+      if (contiguous)
+      {
+        bool i_ok = false, j_ok = false;
+        for (int v : nb)
+          i_ok = i_ok || (v != j && dist_of[v] == b);
+        for (int v : g->nb(j))
+          j_ok = j_ok || (v != i && dist_of[v] == a);
+        if (!i_ok || !j_ok)
+          continue;
+      }
+      delta += w[j][center[a]] - w[j][center[b]];
+      if (delta > 0. && (temp <= 0. || coin(rng) >= exp(-delta / temp)))
+        continue;
+      dist_of[j] = a;
+    }
+    else if (delta > 0. && (temp <= 0. || coin(rng) >= exp(-delta / temp)))
+      continue;
+    dist_of[i] = b;
+    pop[a] += population[j] * (dist_of[j] == a) - population[i];
+    pop[b] += population[i] - population[j] * (dist_of[j] == a);
+    cost += delta;
+    nr_accepted++;
+    if (contiguous)
+    {
+      g->articulation_points(is_art, dist_of, center[a], sc);
+      g->articulation_points(is_art, dist_of, center[b], sc);
+    }
+    keep_best();
+  }
+  // the best partition was kept between recenterings, its centers may still move
+  best = recenter(best_dist, best_center);
+  printf("Boundary moves : %ld tried, %ld accepted, cost %.2lf -> %.2lf\n", nr_moves, nr_accepted, UB, best);
+  if (best >= UB)
+    return false;
+  UB = best;
+  for (int i = 0; i < n; ++i)
+    solution[i] = best_center[best_dist[i]];
+  return true;
+}
@@ -6,8 +6,10 @@
 #include <stdarg.h>
 #include <string>
 #include <cmath>
+#include <algorithm>
 #include "gurobi_c++.h"
 #include "common.h"
+#include "models.h"
 
 using namespace std;
 
@@ -46,15 +48,21 @@ int read_input_data(const char* dimacs_fname, const char* distance_fname, const
     fclose(f);
 
     // read population file
-    f = fopen(population_fname, "r");
+    return read_population(population_fname, g->nr_nodes, population);
+}
+
+int read_population(const char* population_fname, int n, vector<int>& population)
+{
+    FILE* f = fopen(population_fname, "r");
     if(!f) {
       fprintf(stderr, "Failed to open %s\n", population_fname);
       return 1;
     }
     // skip first line about total population
+    char buf[1024];
     fgets(buf, sizeof(buf), f);
-    population.resize(g->nr_nodes);
-    for(int i = 0; i < g->nr_nodes; ++i) {
+    population.resize(n);
+    for(int i = 0; i < n; ++i) {
       int node, pop;
       fscanf(f, "%d %d ", &node, &pop);
       population[node] = pop;
@@ -64,25 +72,23 @@ int read_input_data(const char* dimacs_fname, const char* distance_fname, const
 }
 
 // construct districts from hess variables
-void translate_solution(hess_params& p, vector<int>& sol, int n)
+void translate_solution(GRBModel* model, hess_params& p, vector<int>& sol, int n)
 {
     // translate the solution
     sol.resize(n);
 
+    vector<int> assignment;
+    get_hess_assignment(model, p, assignment);
+
     vector<int> heads(n, 0);
     int cur = 1;
     // firstly assign district number for clusterheads
     for(int i = 0; i < n; ++i)
-    {
-      if(p.F0[i][i])
-        continue;
-      if(p.F1[i][i] || X_V(i,i).get(GRB_DoubleAttr_X) > 0.5)
+      if(assignment[i] == i)
         heads[i] = cur++;
-    }
     for(int i = 0; i < n; ++i)
-      for(int j = 0; j < n; ++j)
-        if(p.F0[i][j]) continue; else if (p.F1[i][j] || X_V(i,j).get(GRB_DoubleAttr_X) > 0.5)
-          sol[i] = heads[j];
+      if(assignment[i] >= 0)
+        sol[i] = heads[assignment[i]];
 }
 
 // prints the solution <node> <district>
@@ -123,29 +129,242 @@ int read_auto_int(const char* arg, int def)
   return def;
 }
 
+// binary hot start : header, then dim doubles
+// the text format of older versions is one value per line and the bound on the last line
+struct hot_start_header
+{
+  char magic[8]; // "RALGHOT"
+  uint32_t version;
+  uint32_t dim;
+  uint64_t hash; // instance_hash, 0 if unknown
+  double bound;
+};
+static const char HOT_START_MAGIC[8] = "RALGHOT";
+static const uint32_t HOT_START_VERSION = 1;
+
+// FNV-1a over the instance : n, sorted neighbourhoods, population, k, L, U
+uint64_t instance_hash(graph* g, const vector<int>& population, int k, int L, int U)
+{
+  uint64_t h = 14695981039346656037ULL;
+  auto mix = [&h](int64_t v) {
+    for(int b = 0; b < 8; ++b, v >>= 8)
+    {
+      h ^= static_cast<uint64_t>(v & 0xff);
+      h *= 1099511628211ULL;
+    }
+  };
+  int n = g->nr_nodes;
+  mix(n);
+  for(int i = 0; i < n; ++i)
+  {
+    vector<int> nb = g->nb(i);
+    sort(nb.begin(), nb.end());
+    mix(nb.size());
+    for(int j : nb)
+      mix(j);
+  }
+  for(int p : population)
+    mix(p);
+  mix(k); mix(L); mix(U);
+  return h;
+}
+
+int load_ralg_hot_start(const char* fname, vector<double>& x, double& bound, uint64_t& hash, bool& is_binary)
+{
+  FILE* f = fopen(fname, "rb");
+  if(!f)
+    return 1;
+  hot_start_header hdr;
+  is_binary = (fread(&hdr, sizeof(hdr), 1, f) == 1 && memcmp(hdr.magic, HOT_START_MAGIC, sizeof(HOT_START_MAGIC)) == 0);
+  if(is_binary)
+  {
+    if(hdr.version != HOT_START_VERSION)
+    {
+      fprintf(stderr, "%s: hot start version %u, expected %u.\n", fname, hdr.version, HOT_START_VERSION);
+      fclose(f);
+      return 1;
+    }
+    x.resize(hdr.dim);
+    if(fread(x.data(), sizeof(double), hdr.dim, f) != hdr.dim)
+    {
+      fprintf(stderr, "%s: truncated, expected %u values.\n", fname, hdr.dim);
+      fclose(f);
+      return 1;
+    }
+    bound = hdr.bound;
+    hash = hdr.hash;
+    fclose(f);
+    return 0;
+  }
+
+  // text, the last value is the bound
+  rewind(f);
+  x.clear();
+  double val;
+  while(fscanf(f, "%lf ", &val) == 1)
+    x.push_back(val);
+  bool complete = feof(f);
+  fclose(f);
+  if(!complete || x.empty())
+  {
+    fprintf(stderr, "%s: not a hot start file.\n", fname);
+    return 1;
+  }
+  bound = x.back();
+  x.pop_back();
+  hash = 0;
+  return 0;
+}
+
 //read ralg initial point from file [fname] to [x0]
-void read_ralg_hot_start(const char* fname, double* x0, int dim)
+void read_ralg_hot_start(const char* fname, double* x0, int dim, uint64_t hash)
 {
+  vector<double> x;
+  double bound;
+  uint64_t file_hash;
+  bool is_binary;
   FILE* f = fopen(fname, "r");
   if(!f)
   {
     fprintf(stderr, "WARNING: Failed to open %s!\n", fname);
     return;
   }
-  for(int i = 0; i < dim; ++i)
+  fclose(f);
+  if(load_ralg_hot_start(fname, x, bound, file_hash, is_binary))
+    exit(1);
+  // a file of another instance is an error, not a bad starting point
+  if(static_cast<int>(x.size()) != dim)
+  {
+    fprintf(stderr, "%s has %lu multipliers, expected %d.\n", fname, x.size(), dim);
+    exit(1);
+  }
+  if(is_binary && file_hash != 0 && file_hash != hash)
+  {
+    fprintf(stderr, "%s belongs to another instance (hash %016llx, expected %016llx).\n", fname,
+      static_cast<unsigned long long>(file_hash), static_cast<unsigned long long>(hash));
+    exit(1);
+  }
+  if(!is_binary || file_hash == 0)
+    fprintf(stderr, "WARNING: %s has no instance hash, only the dimension is checked.\n", fname);
+  copy(x.begin(), x.end(), x0);
+  printf("Hot start from %s, bound %lf\n", fname, bound);
+}
+
+int read_population_list(const char* fname, vector<string>& files)
+{
+  FILE* f = fopen(fname, "r");
+  if(!f)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+  char buf[1024];
+  while(fscanf(f, "%1000s", buf) == 1)
+    files.push_back(buf);
+  fclose(f);
+  if(files.empty())
   {
-    double val = 0.;
-    if(EOF == fscanf(f, "%lf ", &val))
+    fprintf(stderr, "No population files in %s\n", fname);
+    return 1;
+  }
+  return 0;
+}
+
+int read_tract_county_map(const char* fname, int n, vector<int>& county)
+{
+  FILE* f = fopen(fname, "r");
+  if(!f)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return -1;
+  }
+  county.assign(n, -1);
+  int t, c, nr_counties = 0;
+  while(fscanf(f, "%d %d ", &t, &c) == 2)
+  {
+    if(t < 0 || t >= n || c < 0 || county[t] >= 0)
     {
-      fprintf(stderr, "Failure to complete reading ralg x0 from %s.\n", fname);
-      break;
+      fprintf(stderr, "Bad line \"%d %d\" in %s: tract out of range or mapped twice.\n", t, c, fname);
+      fclose(f);
+      return -1;
     }
-    x0[i] = val;
+    county[t] = c;
+    nr_counties = mymax(nr_counties, c + 1);
   }
   fclose(f);
+  for(int i = 0; i < n; ++i)
+    if(county[i] < 0)
+    {
+      fprintf(stderr, "Tract %d is not mapped to a county in %s.\n", i, fname);
+      return -1;
+    }
+  return nr_counties;
+}
+
+int lift_ralg_hot_start(const char* county_fname, const vector<int>& county, const vector<int>& population, double* x0, double* county_opt)
+{
+  int n = county.size();
+  int nc = 0;
+  for(int c : county)
+    nc = mymax(nc, c + 1);
+
+  // county multipliers [alpha, lambda, upsilon], the hash is of the county instance
+  vector<double> xc;
+  double bound;
+  uint64_t hash;
+  bool is_binary;
+  if(load_ralg_hot_start(county_fname, xc, bound, hash, is_binary))
+  {
+    fprintf(stderr, "Failed to read %s\n", county_fname);
+    return 1;
+  }
+  if(xc.size() != static_cast<size_t>(3*nc))
+  {
+    fprintf(stderr, "%s has %lu multipliers, expected %d for %d counties.\n", county_fname, xc.size(), 3*nc, nc);
+    return 1;
+  }
+  if(county_opt)
+    *county_opt = bound;
+
+  // alpha_c prices the assignment of the whole county and splits by population,
+  // lambda_c / L and upsilon_c / U are prices per person and hold for every tract center in the county
+  vector<double> pop_c(nc, 0.);
+  vector<int> size_c(nc, 0);
+  for(int i = 0; i < n; ++i)
+  {
+    pop_c[county[i]] += population[i];
+    size_c[county[i]]++;
+  }
+  for(int i = 0; i < n; ++i)
+  {
+    int c = county[i];
+    x0[i] = xc[c] * ((pop_c[c] > 0.) ? population[i] / pop_c[c] : 1. / size_c[c]);
+    x0[n + i] = xc[nc + c];
+    x0[2*n + i] = xc[2*nc + c];
+  }
+  return 0;
 }
 
-void dump_ralg_hot_start_fname(const char* outname, double* res, int dim, double opt)
+void dump_ralg_hot_start_fname(const char* outname, double* res, int dim, double opt, uint64_t hash)
+{
+  FILE* f = fopen(outname, "wb");
+  if(!f)
+  {
+    fprintf(stderr, "Cannot open %s for dumping ralg result.\n", outname);
+    return;
+  }
+  hot_start_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, HOT_START_MAGIC, sizeof(HOT_START_MAGIC));
+  hdr.version = HOT_START_VERSION;
+  hdr.dim = dim;
+  hdr.hash = hash;
+  hdr.bound = opt;
+  if(fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(res, sizeof(double), dim, f) != static_cast<size_t>(dim))
+    fprintf(stderr, "Failed to write %s.\n", outname);
+  fclose(f);
+}
+void dump_ralg_hot_start_text(const char* outname, const double* res, int dim, double opt)
 {
   FILE* f = fopen(outname, "w");
   if(!f)
@@ -154,15 +373,15 @@ void dump_ralg_hot_start_fname(const char* outname, double* res, int dim, double
     return;
   }
   for(int i = 0; i < dim; ++i)
-    fprintf(f, "%.6lf\n", res[i]);
-  fprintf(f, "%.6lf\n", opt);
+    fprintf(f, "%.17g\n", res[i]);
+  fprintf(f, "%.17g\n", opt);
   fclose(f);
 }
-void dump_ralg_hot_start(const run_params& rp, double* res, int dim, double opt)
+void dump_ralg_hot_start(const run_params& rp, double* res, int dim, double opt, uint64_t hash)
 {
-  string hsfn = string(rp.state) + "_" + rp.model + ".hot";
+  string hsfn = (rp.label.empty() ? string(rp.state) : rp.label) + "_" + rp.model + ".hot";
   const char* outname = hsfn.c_str();
-  dump_ralg_hot_start_fname(outname, res, dim, opt);
+  dump_ralg_hot_start_fname(outname, res, dim, opt, hash);
 }
 
 const char* parse_param(const char* src, const char* prefix)
@@ -204,6 +423,21 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   if(ralg_hot_start && strlen(ralg_hot_start) > 1)
     rp.ralg_hot_start = ralg_hot_start;
   rp.output = stderr;
+  rp.ralg_reduce = 0;
+  rp.concurrent = false;
+  rp.ls_threads = 1;
+  rp.contiguity_heuristic = "native";
+  rp.boundary_moves = 0;
+  rp.multilevel = 0;
+  rp.ralg_stop_gap = 0.;
+  rp.ralg_stop_stall = 0;
+  rp.ralg_lazy_rank = 0;
+  rp.ralg_float = false;
+  rp.ralg_checkpoint_iter = 100;
+  rp.ralg_spec_width = 1;
+  rp.dual_engine = "ralg";
+  rp.hot_start_nearest = 20;
+  rp.reoptimize = false;
 
   char buf[1020];
   string database;
@@ -258,6 +492,52 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
       }
       rp.ralg_hot_start = v;
     }
+    else if((v = parse_param(buf, "ralg_reduce")) != nullptr)
+      rp.ralg_reduce = atoi(v);
+    else if((v = parse_param(buf, "contiguity_heuristic")) != nullptr)
+      rp.contiguity_heuristic = v;
+    else if((v = parse_param(buf, "multilevel")) != nullptr)
+      rp.multilevel = atoi(v);
+    else if((v = parse_param(buf, "boundary_moves")) != nullptr)
+      rp.boundary_moves = atoi(v);
+    else if((v = parse_param(buf, "ls_threads")) != nullptr)
+      rp.ls_threads = atoi(v);
+    else if((v = parse_param(buf, "concurrent")) != nullptr)
+      rp.concurrent = (atoi(v) != 0);
+    else if((v = parse_param(buf, "ralg_stop_gap")) != nullptr)
+      rp.ralg_stop_gap = atof(v);
+    else if((v = parse_param(buf, "ralg_stop_stall")) != nullptr)
+      rp.ralg_stop_stall = atoi(v);
+    else if((v = parse_param(buf, "ralg_lazy_rank")) != nullptr)
+      rp.ralg_lazy_rank = atoi(v);
+    else if((v = parse_param(buf, "ralg_float")) != nullptr)
+      rp.ralg_float = (atoi(v) != 0);
+    else if((v = parse_param(buf, "ralg_checkpoint_iter")) != nullptr)
+      rp.ralg_checkpoint_iter = atoi(v);
+    else if((v = parse_param(buf, "ralg_checkpoint")) != nullptr)
+      rp.ralg_checkpoint = v;
+    else if((v = parse_param(buf, "ralg_spec_width")) != nullptr)
+      rp.ralg_spec_width = atoi(v);
+    else if((v = parse_param(buf, "dual_engine")) != nullptr)
+    {
+      rp.dual_engine = v;
+      clean_nl(rp.dual_engine);
+      if(rp.dual_engine != "ralg" && rp.dual_engine != "volume" && rp.dual_engine != "bundle")
+      {
+        fprintf(stderr, "Config error: unknown dual_engine %s, expected ralg, volume or bundle.\n", rp.dual_engine.c_str());
+        exit(1);
+      }
+    }
+    else if((v = parse_param(buf, "population_list")) != nullptr)
+      rp.population_list = v;
+    else if((v = parse_param(buf, "reoptimize")) != nullptr)
+      rp.reoptimize = (atoi(v) != 0);
+    else if((v = parse_param(buf, "hot_start_county")) != nullptr)
+      rp.hot_start_county = v;
+    else if((v = parse_param(buf, "hot_start_map")) != nullptr)
+      rp.hot_start_map = v;
+    else if((v = parse_param(buf, "hot_start_nearest")) != nullptr)
+      rp.hot_start_nearest = atoi(v);
     else if((v = parse_param(buf, "output")) != nullptr)
     {
       string v_ = v; clean_nl(v_); // do better?
@@ -299,8 +579,19 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   clean_nl(rp.distance_file);
   clean_nl(rp.model);
   clean_nl(rp.ralg_hot_start);
+  clean_nl(rp.ralg_checkpoint);
+  clean_nl(rp.population_list);
+  clean_nl(rp.contiguity_heuristic);
+  clean_nl(rp.hot_start_county);
+  clean_nl(rp.hot_start_map);
   rp.state[2] = '\0';
 
+  if(rp.hot_start_county.empty() != rp.hot_start_map.empty())
+  {
+    fprintf(stderr, "Config error: hot_start_county and hot_start_map go together.\n");
+    exit(1);
+  }
+
   if(database.empty() && (rp.dimacs_file.empty() || rp.population_file.empty() || rp.distance_file.empty()))
   {
     fprintf(stderr, "Missing dimacs/population/distance or database.\n");
@@ -349,6 +640,21 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   cout << "k               = " << rp.k << endl;
   cout << "model           = " << rp.model << endl;
   cout << "ralg_hot_start  = " << rp.ralg_hot_start << endl;
+  cout << "ralg_reduce     = " << rp.ralg_reduce << endl;
+  cout << "ls_threads      = " << rp.ls_threads << endl;
+  cout << "contiguity_heuristic = " << rp.contiguity_heuristic << endl;
+  cout << "boundary_moves  = " << rp.boundary_moves << endl;
+  cout << "multilevel      = " << rp.multilevel << endl;
+  cout << "concurrent      = " << rp.concurrent << ", stop gap " << rp.ralg_stop_gap << ", stall " << rp.ralg_stop_stall << endl;
+  cout << "ralg_lazy_rank  = " << rp.ralg_lazy_rank << endl;
+  cout << "ralg_float      = " << rp.ralg_float << endl;
+  cout << "ralg_checkpoint = " << rp.ralg_checkpoint << " every " << rp.ralg_checkpoint_iter << endl;
+  cout << "ralg_spec_width = " << rp.ralg_spec_width << endl;
+  cout << "dual_engine     = " << rp.dual_engine << endl;
+  cout << "population_list = " << rp.population_list << endl;
+  cout << "reoptimize      = " << rp.reoptimize << endl;
+  cout << "hot_start_county = " << rp.hot_start_county << " through " << rp.hot_start_map << endl;
+  cout << "hot_start_nearest = " << rp.hot_start_nearest << endl;
 //  cout << "output          = " << rp.output << endl;
 
   return rp;
@@ -3,6 +3,7 @@
 #include "graph.h"
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "common.h"
 
 using namespace std;
@@ -11,15 +12,31 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
 
 int read_input_data(const char* dimacs_fname, const char* distance_fname, const char* population_fname, // INPUTS
                      graph* &g, vector<vector<int> >& dist, vector<int>& population); // OUTPUTS
+int read_population(const char* population_fname, int n, vector<int>& population);
+// population files of a batch run, whitespace separated, returns 0 on success
+int read_population_list(const char* fname, vector<string>& files);
 // construct districts from hess variables
-void translate_solution(hess_params& p, vector<int>& sol, int n);
+void translate_solution(GRBModel* model, hess_params& p, vector<int>& sol, int n);
 // prints the solution <node> <district>
 void printf_solution(const vector<int>& sol, const char* fname=NULL);
 void calculate_UL(const vector<int>& population, int k, int* L, int* U);
 int read_auto_int(const char*, int);
+// fingerprint of the instance in hot start files : graph (after connect), population, k, L, U
+uint64_t instance_hash(graph* g, const vector<int>& population, int k, int L, int U);
+// hot start file in either format, hash is 0 for text files (no fingerprint), returns 0 on success
+int load_ralg_hot_start(const char* fname, vector<double>& x, double& bound, uint64_t& hash, bool& is_binary);
 //read ralg initial point from file [fname] to [x0]
-void read_ralg_hot_start(const char* fname, double* x0, int dim);
-void dump_ralg_hot_start_fname(const char*, double* res, int dim, double opt);
-void dump_ralg_hot_start(const run_params& rp, double* res, int dim, double opt);
+// a missing file is a warning, a file of another dimension or instance (hash) stops the run
+void read_ralg_hot_start(const char* fname, double* x0, int dim, uint64_t hash);
+// tract -> county lines "<tract> <county>" (vertex indices), every tract once, returns the number of counties or -1
+int read_tract_county_map(const char* fname, int n, vector<int>& county);
+// county-level ralg hot start to tract-level multipliers : alpha split by population share, lambda and upsilon copied
+// x0 has 3 * county.size() entries, county_opt (optional) gets the value on the last line, returns 0 on success
+int lift_ralg_hot_start(const char* county_fname, const vector<int>& county, const vector<int>& population, double* x0, double* county_opt = nullptr);
+// binary hot start, hash 0 if the instance is unknown
+void dump_ralg_hot_start_fname(const char*, double* res, int dim, double opt, uint64_t hash);
+// text format of older versions (full precision)
+void dump_ralg_hot_start_text(const char* outname, const double* res, int dim, double opt);
+void dump_ralg_hot_start(const run_params& rp, double* res, int dim, double opt, uint64_t hash);
 int ffprintf(FILE* f, const char* arg, ...);
 #endif
@@ -5,14 +5,138 @@
 #include <algorithm>
 #include <iostream>
 #include <queue>
+#include <thread>
+#include <mutex>
 #include "common.h"
 #include "graph.h"
 #include "models.h"
 #include "ralg/ralg.h"
+#include "ralg/volume.h"
+#include "ralg/bundle.h"
 #include "io.h"
 
+const unsigned int ReduceInitialIter = 200; // full dimension iterations before reducing the dual
+const unsigned int ReduceRoundIter = 500;   // iterations between re-expansion checks
+const unsigned int StopCheckIter = 25;      // iterations between fixing counts of ralg_stop_stall
+
+// r-algorithm over a subset idx of the multipliers, the remaining ones are frozen at their values in x
+// x is updated with the best point found, returns its value
+static double ralg_reduced(const ralg_options& opt, const function<bool(const double*, double&, double*)>& cb,
+  const ralg_batch_cb& cb_batch, int dim, const vector<int>& idx, double* x)
+{
+  int dim_r = idx.size();
+  vector<double> full(x, x + dim), full_grad(dim), x0(dim_r), res(dim_r);
+  for (int t = 0; t < dim_r; ++t)
+    x0[t] = res[t] = x[idx[t]];
+  auto cb_reduced = [&](const double* xr, double& f_val, double* grad) {
+    for (int t = 0; t < dim_r; ++t)
+      full[idx[t]] = xr[t];
+    if (!cb(full.data(), f_val, full_grad.data()))
+      return false;
+    for (int t = 0; t < dim_r; ++t)
+      grad[t] = full_grad[idx[t]];
+    return true;
+  };
+  ralg_batch_cb batch_reduced;
+  int width = opt.spec_width;
+  vector<double> full_b, full_grad_b;
+  vector<double*> full_p, full_grad_p;
+  if (cb_batch && width > 1)
+  {
+    full_b.resize((size_t)width * dim);
+    full_grad_b.resize((size_t)width * dim);
+    for (int s = 0; s < width; ++s)
+    {
+      copy(x, x + dim, full_b.begin() + (size_t)s * dim);
+      full_p.push_back(full_b.data() + (size_t)s * dim);
+      full_grad_p.push_back(full_grad_b.data() + (size_t)s * dim);
+    }
+    batch_reduced = [&](unsigned int count, const double* const* xr, double* f_val, double* const* grad) {
+      for (unsigned int s = 0; s < count; ++s)
+        for (int t = 0; t < dim_r; ++t)
+          full_p[s][idx[t]] = xr[s][t];
+      if (!cb_batch(count, full_p.data(), f_val, full_grad_p.data()))
+        return false;
+      for (unsigned int s = 0; s < count; ++s)
+        for (int t = 0; t < dim_r; ++t)
+          grad[s][t] = full_grad_p[s][idx[t]];
+      return true;
+    };
+  }
+  double f = ralg(&opt, cb_reduced, dim_r, x0.data(), res.data(), RALG_MAX, batch_reduced);
+  for (int t = 0; t < dim_r; ++t)
+    x[idx[t]] = res[t];
+  return f;
+}
+
+// after an initial full pass, the L/U multipliers of vertices whose W_j keeps them away from the k best
+// are frozen and removed from the dual, ralg then runs in rounds over alpha and the L/U multipliers
+// of the keep*k best candidates; a round that brings a frozen vertex into the k best re-expands the set
+static double solveReducedDual(const ralg_options& opt, const function<bool(const double*, double&, double*)>& cb,
+  const ralg_batch_cb& cb_batch, int n, int k, int keep, const vector<double>& W, double* x0, double* best)
+{
+  int dim = 3 * n;
+  unsigned int budget = opt.itermax;
+  ralg_options o = opt;
+  o.itermax = mymin(budget, ReduceInitialIter);
+  double f_best = ralg(&o, cb, dim, x0, best, RALG_MAX, cb_batch);
+  unsigned int used = o.itermax;
+
+  int nr_keep = mymin(n, keep * k);
+  vector<bool> active(n, false);
+  vector<int> order(n), idx;
+  vector<double> grad(dim);
+  while (used < budget && !(opt.should_stop && opt.should_stop()))
+  {
+    // evaluate at the best point to rank the candidates (also refreshes W)
+    double f_val;
+    if (!cb(best, f_val, grad.data()))
+      break;
+    for (int j = 0; j < n; ++j)
+      order[j] = j;
+    nth_element(order.begin(), order.begin() + nr_keep - 1, order.end(), [&W](int i1, int i2) { return W[i1] < W[i2]; });
+    partial_sort(order.begin(), order.begin() + k, order.begin() + nr_keep, [&W](int i1, int i2) { return W[i1] < W[i2]; });
+
+    // re-expansion check : a new vertex among the k best means the frozen part moved
+    bool expand = false;
+    for (int t = 0; t < k; ++t)
+      if (!active[order[t]])
+        expand = true;
+    if (!expand && used > ReduceInitialIter)
+    {
+      printf("Reduced dual is stable, done\n");
+      break;
+    }
+    for (int t = 0; t < nr_keep; ++t)
+      active[order[t]] = true;
+
+    idx.clear();
+    for (int i = 0; i < n; ++i)
+      idx.push_back(i); // alpha
+    for (int j = 0; j < n; ++j)
+      if (active[j])
+      {
+        idx.push_back(n + j);     // lambda
+        idx.push_back(2 * n + j); // upsilon
+      }
+    printf("Reduced dual: dimension %lu of %d\n", idx.size(), dim);
+
+    o.itermax = mymin(budget - used, ReduceRoundIter);
+    vector<double> x(best, best + dim);
+    double f = ralg_reduced(o, cb, cb_batch, dim, idx, x.data());
+    used += o.itermax;
+    if (f > f_best)
+    {
+      f_best = f;
+      copy(x.begin(), x.end(), best);
+    }
+  }
+  return f_best;
+}
+
 double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k, 
-  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity)
+  vector<vector<double>>& LB1, vector<double>& LB0, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity,
+  vector<double>* warm_start, lagrange_link* link)
 {
   double LB = -MYINFINITY;
 
@@ -25,13 +149,13 @@ double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<i
   double * bestMultipliers = new double[dim]; 
   double * multipliers = new double[dim];
 
-  auto cb_grad_func = [g, &w, &population, L, U, k, &W, &w_hat, &currentCenters, &LB, &LB1, dim, exploit_contiguity](const double* multipliers, double& f_val, double* grad) 
+  auto cb_grad_func = [g, &w, &population, L, U, k, &W, &w_hat, &currentCenters, &LB, &LB1, &LB0, dim, exploit_contiguity](const double* multipliers, double& f_val, double* grad) 
   {
     solveInnerProblem(g, multipliers, L, U, k, population, w, w_hat, W, grad, f_val, currentCenters);
     if (exploit_contiguity)
-      update_LB_contiguity(g, W, currentCenters, f_val, w_hat, LB1);
+      update_LB_contiguity(g, W, currentCenters, f_val, w_hat, LB1, LB0);
     else
-      update_LB(W, currentCenters, f_val, w_hat, LB1);
+      update_LB(W, currentCenters, f_val, w_hat, LB1, LB0);
 
     // update incubments?
     if (f_val > LB)
@@ -40,19 +164,181 @@ double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<i
     return true;
   };
 
+  // speculative line search : every trial point has its own inner problem workspace (slot 0 shares w_hat),
+  // LB1/LB0 are merged afterwards by threads owning disjoint column ranges
+  int nr_spec = mymax(1, rp.ralg_spec_width);
+  int n = g->nr_nodes;
+  vector<vector<vector<double>>> spec_w_hat(nr_spec - 1, vector<vector<double>>(n, vector<double>(n)));
+  vector<vector<double>> spec_W(nr_spec, vector<double>(n));
+  vector<vector<bool>> spec_centers(nr_spec, vector<bool>(n));
+  auto cb_batch = [&](unsigned int count, const double* const* x, double* f_val, double* const* grad)
+  {
+    auto hat = [&](unsigned int s) -> vector<vector<double>>& { return (s == 0) ? w_hat : spec_w_hat[s - 1]; };
+    vector<thread> workers;
+    for (unsigned int s = 1; s < count; ++s)
+      workers.emplace_back([&, s]() { solveInnerProblem(g, x[s], L, U, k, population, w, hat(s), spec_W[s], grad[s], f_val[s], spec_centers[s]); });
+    solveInnerProblem(g, x[0], L, U, k, population, w, hat(0), spec_W[0], grad[0], f_val[0], spec_centers[0]);
+    for (auto& t : workers)
+      t.join();
+    workers.clear();
+
+    auto merge = [&](int j_begin, int j_end) {
+      for (unsigned int s = 0; s < count; ++s)
+        if (exploit_contiguity)
+          update_LB_contiguity(g, spec_W[s], spec_centers[s], f_val[s], hat(s), LB1, LB0, j_begin, j_end);
+        else
+          update_LB(spec_W[s], spec_centers[s], f_val[s], hat(s), LB1, LB0, j_begin, j_end);
+    };
+    for (unsigned int s = 1; s < count; ++s)
+      workers.emplace_back(merge, (int)((long)n * s / count), (int)((long)n * (s + 1) / count));
+    merge(0, n / count);
+    for (auto& t : workers)
+      t.join();
+
+    for (unsigned int s = 0; s < count; ++s)
+      if (f_val[s] > LB)
+        LB = f_val[s];
+    return true;
+  };
+  ralg_batch_cb batch;
+  if (nr_spec > 1)
+    batch = cb_batch;
+
   // try to load hot start if any
-  if (ralg_hot_start)
-    read_ralg_hot_start(ralg_hot_start_fname, multipliers, dim);
-  else
-    for (int i = 0; i < dim; ++i)
-      multipliers[i] = 1.; // whatever
+  for (int i = 0; i < dim; ++i)
+    multipliers[i] = 1.; // whatever
+  uint64_t hash = instance_hash(g, population, k, L, U);
+  if (warm_start && static_cast<int>(warm_start->size()) == dim)
+    copy(warm_start->begin(), warm_start->end(), multipliers);
+  else if (ralg_hot_start && ralg_hot_start_fname)
+    read_ralg_hot_start(ralg_hot_start_fname, multipliers, dim, hash);
+  else if (!rp.hot_start_county.empty())
+  {
+    // county-level multipliers lifted to this (tract) level
+    vector<int> county;
+    if (read_tract_county_map(rp.hot_start_map.c_str(), n, county) < 0 ||
+        lift_ralg_hot_start(rp.hot_start_county.c_str(), county, population, multipliers))
+    {
+      fprintf(stderr, "WARNING: Failed to lift %s, starting from ones.\n", rp.hot_start_county.c_str());
+      for (int i = 0; i < dim; ++i)
+        multipliers[i] = 1.;
+    }
+    else
+      printf("Lifted the hot start from %s\n", rp.hot_start_county.c_str());
+  }
 
   ralg_options opt = defaultOptions; opt.output_iter = 1; opt.is_monotone = false;
   if (ralg_hot_start) opt.itermax = 100;
-  LB = ralg(&opt, cb_grad_func, dim, multipliers, bestMultipliers, RALG_MAX); // lower bound from lagrangian
+  if (rp.ralg_lazy_rank > 0) opt.lazy_rank = rp.ralg_lazy_rank;
+  opt.float_b = rp.ralg_float;
+  opt.spec_width = nr_spec;
+  // W and the centers of the trial ralg moves to, as the sequential run leaves them
+  if (nr_spec > 1)
+    opt.spec_accepted = [&](unsigned int s)
+    {
+      W = spec_W[s];
+      currentCenters = spec_centers[s];
+    };
+  if (!rp.ralg_checkpoint.empty())
+  {
+    if (rp.ralg_reduce > 0)
+      printf("ralg_checkpoint is not supported with ralg_reduce, ignored\n");
+    else
+    {
+      opt.checkpoint = rp.ralg_checkpoint.c_str();
+      opt.checkpoint_iter = rp.ralg_checkpoint_iter;
+      // a checkpoint of another instance or of the other variant is not resumed
+      opt.checkpoint_id = hash ^ (exploit_contiguity ? 0x9e3779b97f4a7c15ULL : 0ULL);
+      // LB1 and LB0 collected before the checkpoint stay valid bounds, keep them across the restart
+      opt.checkpoint_extra = [&LB1, &LB0](FILE* f, bool save)
+      {
+        int n = LB0.size();
+        if (save)
+        {
+          for (int i = 0; i < n; ++i)
+            if (fwrite(LB1[i].data(), sizeof(double), n, f) != (size_t)n)
+              return false;
+          return fwrite(LB0.data(), sizeof(double), n, f) == (size_t)n;
+        }
+        vector<double> row(n);
+        for (int i = 0; i <= n; ++i)
+        {
+          if (fread(row.data(), sizeof(double), n, f) != (size_t)n)
+            return false;
+          vector<double>& to = (i < n) ? LB1[i] : LB0;
+          for (int j = 0; j < n; ++j)
+            to[j] = mymax(to[j], row[j]);
+        }
+        return true;
+      };
+    }
+  }
+  // next to the heuristics : publish the centers, stop on the gap to their UB or when the fixings stall
+  long best_nr_fixed = -1;
+  int nr_stalled = 0;
+  unsigned int nr_polls = 0;
+  if (link)
+    opt.should_stop = [&]()
+    {
+      {
+        lock_guard<mutex> lock(link->mutex);
+        link->centers.clear();
+        for (int j = 0; j < n; ++j)
+          if (currentCenters[j])
+            link->centers.push_back(j);
+      }
+      double UB = link->UB.load();
+      if (UB >= MYINFINITY)
+        return false;
+      if (rp.ralg_stop_gap > 0. && UB - LB <= rp.ralg_stop_gap * myabs(UB))
+      {
+        printf("Lagrangian stops : LB = %.2lf is within %g of UB = %.2lf\n", LB, rp.ralg_stop_gap, UB);
+        return true;
+      }
+      if (rp.ralg_stop_stall <= 0 || ++nr_polls % StopCheckIter != 0)
+        return false;
+      long nr_fixed = 0;
+      for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+          if (LB1[i][j] > UB + VarFixingEpsilon)
+            nr_fixed++;
+      for (int j = 0; j < n; ++j)
+        if (LB0[j] > UB + VarFixingEpsilon)
+          nr_fixed++;
+      if (nr_fixed > best_nr_fixed)
+      {
+        best_nr_fixed = nr_fixed;
+        nr_stalled = 0;
+      }
+      else if (++nr_stalled >= rp.ralg_stop_stall)
+      {
+        printf("Lagrangian stops : %ld fixings against UB = %.2lf, none new in %d checks\n", nr_fixed, UB, nr_stalled);
+        return true;
+      }
+      return false;
+    };
+  copy(multipliers, multipliers + dim, bestMultipliers); // in case ralg never improves x0
+  if (rp.dual_engine == "volume")
+  {
+    volume_options vo = defaultVolumeOptions; vo.output_iter = 10;
+    if (ralg_hot_start) vo.itermax = 300;
+    LB = volume(&vo, cb_grad_func, dim, multipliers, bestMultipliers, RALG_MAX);
+  }
+  else if (rp.dual_engine == "bundle")
+  {
+    bundle_options bo = defaultBundleOptions; bo.output_iter = 10;
+    if (ralg_hot_start) bo.itermax = 300;
+    LB = bundle(&bo, cb_grad_func, dim, multipliers, bestMultipliers, RALG_MAX);
+  }
+  else if (rp.ralg_reduce <= 0)
+    LB = ralg(&opt, cb_grad_func, dim, multipliers, bestMultipliers, RALG_MAX, batch); // lower bound from lagrangian
+  else
+    LB = solveReducedDual(opt, cb_grad_func, batch, g->nr_nodes, k, rp.ralg_reduce, W, multipliers, bestMultipliers);
 
   // dump result to "state_model.hot"
-  dump_ralg_hot_start(rp, bestMultipliers, dim, LB);
+  dump_ralg_hot_start(rp, bestMultipliers, dim, LB, hash);
+  if (warm_start)
+    warm_start->assign(bestMultipliers, bestMultipliers + dim);
 
   delete [] multipliers;
   delete [] bestMultipliers;
@@ -60,10 +346,30 @@ double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<i
   return LB;
 }
 
+// if a current center j is forced out, the inner problem takes the best non-center instead
+void update_LB0(const vector<double>& W, const vector<bool>& currentCenters, double f_val, vector<double>& LB0,
+  int j_begin, int j_end)
+{
+  int n = currentCenters.size();
+  if (j_end < 0) j_end = n;
+  double minW = MYINFINITY;
+  for (int i = 0; i < n; ++i)
+    if (!currentCenters[i])
+      minW = mymin(minW, W[i]);
+  if (minW == MYINFINITY)
+    return; // k == n, every vertex is a center
+  for (int j = j_begin; j < j_end; ++j)
+    if (currentCenters[j])
+      LB0[j] = mymax(LB0[j], f_val - W[j] + minW);
+}
+
 void update_LB(const vector<double>& W, const vector<bool>& currentCenters, double f_val, 
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1)
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, vector<double>& LB0, int j_begin, int j_end)
 {
+  update_LB0(W, currentCenters, f_val, LB0, j_begin, j_end);
+
   int n = currentCenters.size();
+  if (j_end < 0) j_end = n;
   double maxW = -MYINFINITY;
   double minW = MYINFINITY;
 
@@ -77,7 +383,7 @@ void update_LB(const vector<double>& W, const vector<bool>& currentCenters, doub
       minW = mymin(minW, W[i]);
 
   // update LB1
-  for (int j = 0; j < n; ++j)
+  for (int j = j_begin; j < j_end; ++j)
   {
     if (!currentCenters[j])
     {
@@ -101,9 +407,12 @@ void update_LB(const vector<double>& W, const vector<bool>& currentCenters, doub
 }
 
 void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1)
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, vector<double>& LB0, int j_begin, int j_end)
 {
+  update_LB0(W, currentCenters, f_val, LB0, j_begin, j_end);
+
   int n = currentCenters.size();
+  if (j_end < 0) j_end = n;
   double maxW = -MYINFINITY;
 
   // determine value for maxW
@@ -113,7 +422,7 @@ void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>&
 
   // compute special distances 
   vector<double> dist(g->nr_nodes);
-  for (int j = 0; j < n; ++j)
+  for (int j = j_begin; j < j_end; ++j)
   {
     // a particular shortest path computation from j to all nodes
     priority_queue< pair<double, int>, vector <pair<double, int>>, greater<pair<double, int>> > pq;
@@ -243,3 +552,89 @@ void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k,
     if (upsilon[i] < 0)
       grad[i + 2 * g->nr_nodes] = -grad[i + 2 * g->nr_nodes];
 }
+
+int propagate_fixings(vector<vector<bool>>& F0, vector<vector<bool>>& F1, int k)
+{
+  int n = F0.size();
+  int numNew = 0;
+  bool changed;
+  do {
+    changed = false;
+    // a center fixed out cannot take anybody
+    for (int j = 0; j < n; ++j)
+      if (F0[j][j])
+        for (int i = 0; i < n; ++i)
+          if (!F0[i][j])
+          {
+            F0[i][j] = true;
+            changed = true;
+          }
+
+    for (int i = 0; i < n; ++i)
+    {
+      int last = -1, cnt = 0, one = -1;
+      for (int j = 0; j < n; ++j)
+      {
+        if (!F0[i][j])
+        {
+          last = j;
+          cnt++;
+        }
+        if (F1[i][j])
+          one = j;
+      }
+      if (cnt == 0)
+      {
+        fprintf(stderr, "WARNING: every assignment of %d is fixed to zero, skipping fixing propagation.\n", i);
+        return numNew;
+      }
+      // the only option left for i
+      if (cnt == 1 && one < 0)
+      {
+        F1[i][last] = true; one = last;
+        numNew++; changed = true;
+      }
+      if (one < 0)
+        continue;
+      // i joins j = one : the rest of row i vanishes and j must be a center
+      for (int j = 0; j < n; ++j)
+        if (j != one && !F0[i][j])
+        {
+          F0[i][j] = true;
+          changed = true;
+        }
+      if (!F1[one][one])
+      {
+        F1[one][one] = true;
+        numNew++; changed = true;
+      }
+    }
+
+    // count centers fixed to one and the ones still possible
+    int numOne = 0, numLeft = 0;
+    for (int j = 0; j < n; ++j)
+    {
+      if (F1[j][j]) numOne++;
+      if (!F0[j][j]) numLeft++;
+    }
+    if (numOne == k && numLeft > k) // all centers are known
+    {
+      for (int j = 0; j < n; ++j)
+        if (!F1[j][j] && !F0[j][j])
+        {
+          F0[j][j] = true;
+          changed = true;
+        }
+    }
+    else if (numLeft == k && numOne < k) // exactly k candidates left
+    {
+      for (int j = 0; j < n; ++j)
+        if (!F0[j][j] && !F1[j][j])
+        {
+          F1[j][j] = true;
+          numNew++; changed = true;
+        }
+    }
+  } while (changed);
+  return numNew;
+}
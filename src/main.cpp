@@ -9,10 +9,11 @@
 #include <cstring>
 #include <chrono>
 #include <string>
+#include <thread>
+#include <future>
+#include <mutex>
 #include "common.h"
 
-const double VarFixingEpsilon = 0.00001;
-
 using namespace std;
 extern const char* gitversion;
 
@@ -25,140 +26,38 @@ void dealloc_vec(vector<T>& v, const char* name)
     printf("Failed to release %s memory, %ld remaining.\n", name, v.capacity());
   }
 }
-int main(int argc, char *argv[])
-{
-  printf("Districting, build %s\n", gitversion);
-  if (argc < 2) {
-    printf("Usage: %s <config> [state [ralg_hot_start]]\n\
-  Available models:\n\
-  \thess\t\tHess model\n\
-  \tshir\t\tHess model with SHIR\n\
-  \tmcf\t\tHess model with MCF\n\
-  \tcut\t\tHess model with CUT\n\
-  \tlcut\t\tHess model with LCUT\n", argv[0]);
-    return 0;
-  }
-
-  // parse config
-  run_params rp;
-  rp = read_config(argv[1], (argc>2 ? argv[2] : ""), (argc>3 ? argv[3] : ""));
-  int L = rp.L; int U = rp.U;
-  bool ralg_hot_start = !rp.ralg_hot_start.empty();
-  const char* ralg_hot_start_fname = (rp.ralg_hot_start.empty() ? nullptr : rp.ralg_hot_start.c_str());
-
-  // read inputs
-  graph* g = nullptr;
-  vector<vector<int> > dist;
-  vector<int> population;
-  if (read_input_data(rp.dimacs_file.c_str(), rp.distance_file.c_str(), rp.population_file.c_str(), g, dist, population))
-    return 1; // failure
-
-  int k = (rp.k == 0) ? g->get_k() : rp.k;
-
-  if (L == 0 || U == 0)
-    calculate_UL(population, k, &L, &U);
-
-  printf("Model input: L = %d, U = %d, k = %d.\n", L, U, k);
-
-  // dump run args to output
-  ffprintf(rp.output, "%s, %s, %d, %d, %d, %d, ", rp.state, rp.model.c_str(), g->nr_nodes, k, L, U);
-
-  g->connect(dist);
-
-  // check connectivity
-  if (!g->is_connected())
-  {
-    printf("Problem is infeasible (not connected!)\n");
-    ffprintf(rp.output, "disconnected\n");
-    fclose(rp.output);
-    return 1;
-  }
-
-  if (g->nr_nodes <= 0)
-  {
-    printf("empty graph\n");
-    ffprintf(rp.output, "empty graph\n");
-    fclose(rp.output);
-    return 1;
-  }
 
-  if (dist.size() != g->nr_nodes || population.size() != g->nr_nodes)
+// Gurobi model of the previous batch instance, re-optimized in place for the next population (reoptimize 1)
+struct reopt_state
+{
+  GRBEnv* env;
+  GRBModel* model;
+  HessCallback* cb;
+  hess_params p; // cb refers to it
+  vector<int> solution; // center of every vertex in the last solution, empty if none
+  reopt_state() : env(nullptr), model(nullptr), cb(nullptr) {}
+  ~reopt_state() { clear(); }
+  void clear()
   {
-    printf("dist/population size != n, expected %d\n", g->nr_nodes);
-    ffprintf(rp.output, "bad input data\n");
-    fclose(rp.output);
-    return 1;
+    delete cb; delete model; delete env;
+    cb = nullptr; model = nullptr; env = nullptr;
+    solution.clear();
   }
+};
 
-  long total_pop = 0L;
-  for (int p : population)
-    total_pop += p;
-  printf("Model input: total population = %ld\n", total_pop);
-
-  int nr_nodes = g->nr_nodes;
-
-  string arg_model = rp.model;
-
-  bool exploit_contiguity = false;
-  if (arg_model != "hess")
-    exploit_contiguity = true;
-
-  // set objective function coefficients
-  vector<vector<double>> w(nr_nodes, vector<double>(nr_nodes)); // this is the weight matrix in the objective function
-  for (int i = 0; i < nr_nodes; i++)
-    for (int j = 0; j < nr_nodes; j++)
-      w[i][j] = get_objective_coefficient(dist, population, i, j);
-
-  // dist is not used anymore
-  dealloc_vec(dist, "dist");
-
-  auto start = chrono::steady_clock::now();
-
-  // apply Lagrangian 
-  vector< vector<double> > LB1(nr_nodes, vector<double>(nr_nodes, -MYINFINITY)); // LB1[i][j] is a lower bound on problem objective if we fix x[i][j] = 1
-  auto lagrange_start = chrono::steady_clock::now();
-  double LB = solveLagrangian(g, w, population, L, U, k, LB1, ralg_hot_start, ralg_hot_start_fname, rp, exploit_contiguity); // lower bound on problem objective, coming from lagrangian
-  chrono::duration<double> lagrange_duration = chrono::steady_clock::now() - lagrange_start;
-  ffprintf(rp.output, "%.2lf, %.2lf, ", LB, lagrange_duration.count());
-
-  auto dump_maybe_inf = [&rp](double val) { if (myabs(val-MYINFINITY) <= 1.) ffprintf(rp.output, "infinity, "); else ffprintf(rp.output, "%.2lf, ", val); };
-
-  // run a heuristic
-  double UB = MYINFINITY;
-  int maxIterations = 10;   // 10 iterations is often sufficient
-  auto heuristic_start = chrono::steady_clock::now();
-  vector<int> heuristicSolution = HessHeuristic(g, w, population, L, U, k, UB, maxIterations, false);
-  chrono::duration<double> heuristic_duration = chrono::steady_clock::now() - heuristic_start;
-  dump_maybe_inf(UB);
-  ffprintf(rp.output, "%.2lf, ", heuristic_duration.count());
-  printf("Best solution after %d of HessHeuristic is %.2lf\n", maxIterations, UB);
-
-  // run local search
-  auto LS_start = chrono::steady_clock::now();
-  bool ls_ok = LocalSearch(g, w, population, L, U, k, heuristicSolution, UB);
-  chrono::duration<double> LS_duration = chrono::steady_clock::now() - LS_start;
-  dump_maybe_inf(UB);
-  ffprintf(rp.output, "%.2lf, ", LS_duration.count());
-  printf("Best solution after local search is %.2lf\n", UB);
-
-  if (arg_model != "hess" && ls_ok)  // solve contiguity-constrained problem, restricted to centers from heuristicSolution
-  {
-    UB = MYINFINITY;
-    auto contiguity_start = chrono::steady_clock::now();
-    ContiguityHeuristic(heuristicSolution, g, w, population, L, U, k, UB, "shir"); // arg_model);
-    chrono::duration<double> contiguity_duration = chrono::steady_clock::now() - contiguity_start;
-    dump_maybe_inf(UB);
-    ffprintf(rp.output, "%.2lf, ", contiguity_duration.count());
-  } else ffprintf(rp.output, "n/a, n/a, ");
-
-  // determine which variables can be fixed
-  vector<vector<bool>> F0(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_0
-  vector<vector<bool>> F1(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_1
+// F0/F1 from the Lagrangian bounds and an upper bound, propagated, returns the percentage of fixed variables
+static double compute_fixings(const vector<vector<double>>& LB1, const vector<double>& LB0, double UB, int k,
+  vector<vector<bool>>& F0, vector<vector<bool>>& F1)
+{
+  int nr_nodes = LB0.size();
+  F0.assign(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_0
+  F1.assign(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_1
   for (int i = 0; i < nr_nodes; ++i)
     for (int j = 0; j < nr_nodes; ++j)
       if (LB1[i][j] > UB + VarFixingEpsilon) F0[i][j] = true;
-  // LB1 is not used anymore, release memory
-  dealloc_vec(LB1, "LB1");
+  for (int j = 0; j < nr_nodes; ++j)
+    if (LB0[j] > UB + VarFixingEpsilon && !F0[j][j]) F1[j][j] = true; // j must be a center
+  propagate_fixings(F0, F1, k);
   //report the number of fixings
   int numFixedZero = 0;
   int numFixedOne = 0;
@@ -181,63 +80,269 @@ int main(int argc, char *argv[])
   printf("Number of centers left            = %d\n", numCentersLeft);
   double perc_var_fixed = (double)(nr_nodes*nr_nodes - numUnfixed) / (nr_nodes*nr_nodes);
   printf("Percentage of vars fixed = %.2lf\n", perc_var_fixed);
-  ffprintf(rp.output, "%.2lf, ", perc_var_fixed);
+  return perc_var_fixed;
+}
+
+// optimizes the model and writes IP time, total time, callback stats, max p_v / U, objective, gap, bound,
+// nodes and Y/N to rp.output, the solution goes to label_model.sol and to solution (empty if none)
+// polish (optional) improves the assignment of an incumbent left by the time limit and its objective, returns whether it did
+static void optimize_and_report(const run_params& rp, const char* label, GRBModel* model, hess_params& p, HessCallback* cb,
+  int nr_nodes, int max_pv, int U, chrono::steady_clock::time_point start, vector<int>& solution,
+  function<bool(vector<int>&, double&)> polish = nullptr)
+{
+  //optimize the model
+  auto IP_start = chrono::steady_clock::now();
+
+  model->optimize();
+
+  chrono::duration<double> IP_duration = chrono::steady_clock::now() - IP_start;
+  ffprintf(rp.output, "%.2lf, ", IP_duration.count());
+  printf("IP duration time: %lf seconds\n", IP_duration.count());
+  chrono::duration<double> duration = chrono::steady_clock::now() - start;
+  printf("Total time elapsed: %lf seconds\n", duration.count());
+  ffprintf(rp.output, "%.2lf, ", duration.count());
+  if (cb)
+  {
+    printf("Number of callbacks: %d\n", cb->numCallbacks);
+    printf("Time in callbacks: %lf seconds\n", cb->callbackTime);
+    printf("Number of lazy constraints generated: %d\n", cb->numLazyCuts);
+    printf("Number of heuristic solutions from the callback: %d\n", cb->numHeuristicSolutions);
+    ffprintf(rp.output, "%d, %.2lf, %d, ", cb->numCallbacks, cb->callbackTime, cb->numLazyCuts);
+  } else ffprintf(rp.output, "n/a, n/a, n/a, ");
+
+  ffprintf(rp.output, "%.2lf, ", static_cast<double>(max_pv) / static_cast<double>(U));
+
+  solution.clear();
+  bool polished = false;
+  double polished_obj = 0.;
+  if (model->get(GRB_IntAttr_SolCount) > 0)
+  {
+    get_hess_assignment(model, p, solution);
+    if (polish && model->get(GRB_IntAttr_Status) == 9) // time limit
+    {
+      polished_obj = model->get(GRB_DoubleAttr_ObjVal);
+      polished = polish(solution, polished_obj);
+      if (polished)
+        printf("Incumbent after the time limit improved to %.2lf\n", polished_obj);
+    }
+  }
+
+  if (model->get(GRB_IntAttr_Status) == 3) // infeasible
+    ffprintf(rp.output, "infeasible, , , ");
+  else {
+
+    double objbound = model->get(GRB_DoubleAttr_ObjBound);
+
+    // no incumbent solution was found, these values do no make sense
+    if (model->get(GRB_IntAttr_SolCount) == 0)
+      ffprintf(rp.output, "?, ?, ");
+    else
+    {
+      double objval = model->get(GRB_DoubleAttr_ObjVal);
+      double mipgap = model->get(GRB_DoubleAttr_MIPGap)*100.;
+      if (polished)
+      {
+        objval = polished_obj;
+        mipgap = fabs(objval - objbound) / fabs(objval) * 100.; // as GRB_DoubleAttr_MIPGap
+      }
+      ffprintf(rp.output, "%.2lf, %.2lf, ", objval, mipgap);
+    }
+
+    ffprintf(rp.output, "%.2lf, ", objbound);
+  }
+
+  long nodecount = static_cast<long>(model->get(GRB_DoubleAttr_NodeCount));
+  ffprintf(rp.output, "%ld, ", nodecount);
+
+  ffprintf(rp.output, solution.empty() ? "N" : "Y");
+
+  if (model->get(GRB_IntAttr_Status) != 3) {
+    vector<int> sol;
+    if (polished)
+    {
+      // district numbers as translate_solution
+      vector<int> heads(nr_nodes, 0);
+      int cur = 1;
+      for (int i = 0; i < nr_nodes; ++i)
+        if (solution[i] == i)
+          heads[i] = cur++;
+      sol.resize(nr_nodes);
+      for (int i = 0; i < nr_nodes; ++i)
+        sol[i] = heads[solution[i]];
+    }
+    else
+      translate_solution(model, p, sol, nr_nodes);
+    string soln_fn = string(label) + "_" + rp.model + ".sol";
+    printf_solution(sol, soln_fn.c_str());
+  }
+}
+
+// the columns of optimize_and_report for the column generation engine : callbacks are n/a, the bound is the
+// one of the exact pricing ("?" without), the node count is the one of the master IP
+static void solve_cg_and_report(const run_params& rp, const char* label, graph* g, const vector<vector<double>>& w,
+  const vector<int>& population, int L, int U, int k, const vector<vector<bool>>& F0, const vector<int>& start,
+  chrono::steady_clock::time_point start_time, vector<int>& solution)
+{
+  int nr_nodes = g->nr_nodes;
+  int max_pv = *max_element(population.begin(), population.end());
+  GRBEnv env;
+  double LB;
+  int nr_columns;
+  long nodecount;
+  auto IP_start = chrono::steady_clock::now();
+  double objval = solve_district_cg(env, g, w, population, L, U, k, F0, start, 3600., solution, LB, nr_columns, nodecount);
+
+  chrono::duration<double> IP_duration = chrono::steady_clock::now() - IP_start;
+  ffprintf(rp.output, "%.2lf, ", IP_duration.count());
+  printf("IP duration time: %lf seconds\n", IP_duration.count());
+  chrono::duration<double> duration = chrono::steady_clock::now() - start_time;
+  printf("Total time elapsed: %lf seconds\n", duration.count());
+  ffprintf(rp.output, "%.2lf, ", duration.count());
+  ffprintf(rp.output, "n/a, n/a, n/a, ");
+  ffprintf(rp.output, "%.2lf, ", static_cast<double>(max_pv) / static_cast<double>(U));
+
+  if (objval >= MYINFINITY)
+    ffprintf(rp.output, "?, ?, ");
+  else if (LB <= -MYINFINITY)
+    ffprintf(rp.output, "%.2lf, ?, ", objval);
+  else
+    ffprintf(rp.output, "%.2lf, %.2lf, ", objval, fabs(objval - LB) / fabs(objval) * 100.);
+  if (LB <= -MYINFINITY)
+    ffprintf(rp.output, "?, ");
+  else
+    ffprintf(rp.output, "%.2lf, ", LB);
+  ffprintf(rp.output, "%ld, ", nodecount);
+  printf("Column generation : %d columns, objective %.2lf, bound %.2lf\n", nr_columns, objval, LB);
+
+  ffprintf(rp.output, solution.empty() ? "N" : "Y");
+  if (!solution.empty())
+  {
+    // district numbers as translate_solution
+    vector<int> heads(nr_nodes, 0), sol(nr_nodes);
+    int cur = 1;
+    for (int i = 0; i < nr_nodes; ++i)
+      if (solution[i] == i)
+        heads[i] = cur++;
+    for (int i = 0; i < nr_nodes; ++i)
+      sol[i] = solution[i] >= 0 ? heads[solution[i]] : 0;
+    string soln_fn = string(label) + "_" + rp.model + ".sol";
+    printf_solution(sol, soln_fn.c_str());
+  }
+}
 
+// first columns of a CSV row
+static void dump_args(const run_params& rp, const char* label, const char* model, int n, int k, int L, int U)
+{
+  printf("Model input: L = %d, U = %d, k = %d.\n", L, U, k);
+  ffprintf(rp.output, "%s, %s, %d, %d, %d, %d, ", label, model, n, k, L, U);
+}
+
+// model name, "all" or a comma-separated list
+static vector<string> model_list(const string& arg_model)
+{
+  if (arg_model == "all")
+    return {"hess", "shir", "mcf", "cut", "lcut"};
+  vector<string> models;
+  size_t pos = 0;
+  while (pos <= arg_model.size())
+  {
+    size_t comma = arg_model.find(',', pos);
+    if (comma == string::npos)
+      comma = arg_model.size();
+    string m = arg_model.substr(pos, comma - pos);
+    if (!m.empty() && find(models.begin(), models.end(), m) == models.end())
+      models.push_back(m);
+    pos = comma + 1;
+  }
+  return models;
+}
+
+// builds and solves one formulation from the fixings, writes the IP columns
+// with keep_data false g, w and population are released as soon as they are not needed
+static void solve_model(const run_params& rp, const char* label, graph*& g, vector<vector<double>>& w, vector<int>& population,
+  int L, int U, int k, const vector<vector<bool>>& F0, const vector<vector<bool>>& F1, const vector<int>& heuristicSolution, bool ls_ok,
+  bool keep_data, chrono::steady_clock::time_point start, reopt_state* st)
+{
+  int nr_nodes = g->nr_nodes;
+  const string& arg_model = rp.model;
+  if (st)
+    st->clear();
+  GRBEnv* env = nullptr;
+  GRBModel* model = nullptr;
+  HessCallback* cb = nullptr;
+  hess_params local_p;
+  hess_params& p = st ? st->p : local_p;
+  vector<int> solution;
+  bool solved = false;
+  if (arg_model == "cg")
+  {
+    try
+    {
+      solve_cg_and_report(rp, label, g, w, population, L, U, k, F0, ls_ok ? heuristicSolution : vector<int>(), start, solution);
+    }
+    catch (GRBException e) {
+      printf("Error code = %d\n", e.getErrorCode());
+      printf("%s\n", e.getMessage().c_str());
+    }
+    catch (const char* msg) {
+      printf("Exception with message : %s\n", msg);
+    }
+    ffprintf(rp.output, "\n");
+    if (!keep_data)
+    {
+      delete g;
+      g = nullptr;
+      dealloc_vec(population, "population");
+      dealloc_vec(w, "w");
+    }
+    return;
+  }
   try
   {
     // initialize environment and create an empty model
-    GRBEnv env = GRBEnv();
-    GRBModel model = GRBModel(env);
+    env = new GRBEnv();
+    model = new GRBModel(*env);
 
     // get incumbent solution using centers from lagrangian
-    hess_params p;
-    p = build_hess(&model, g, w, population, L, U, k, F0, F1);
+    p = build_hess(model, g, w, population, L, U, k, F0, F1);
 
     // push GUROBI to branch over clusterheads
-    for (int i = 0; i < nr_nodes; ++i)
-      if (IS_X(i, i))
-        X_V(i, i).set(GRB_IntAttr_BranchPriority, 1);
-
-    HessCallback* cb = nullptr;
+    set_center_priority(model, p, 1);
 
     if (arg_model == "shir")
-      build_shir(&model, p, g);
+      build_shir(model, p, g);
     else if (arg_model == "mcf")
-      build_mcf(&model, p, g);
+      build_mcf(model, p, g);
     else if (arg_model == "cut")
-      cb = build_cut(&model, p, g, population);
+      cb = build_cut(model, p, g, population, L, U);
     else if (arg_model == "lcut")
-      cb = build_lcut(&model, p, g, population, U);
+      cb = build_lcut(model, p, g, population, L, U);
     else if (arg_model != "hess") {
       printf("ERROR: Unknown model : %s\n", arg_model.c_str());
       exit(1);
     }
 
+    // an incumbent left by the time limit is polished by boundary moves, which need the data
+    if (rp.boundary_moves > 0)
+      keep_data = true;
+
     // preserve memory here
-    if(!cb)
+    if(!cb && !keep_data)
     {
       delete g;
       g = nullptr;
     }
 
     //TODO change user-interactive?
-    model.set(GRB_DoubleParam_TimeLimit, 3600.); // 1 hour
-    //model.set(GRB_IntParam_Threads, 10); // limit to 10 threads
-    model.set(GRB_DoubleParam_NodefileStart, 10); // 10 GB
-    model.set(GRB_IntParam_Method, 3);  // use concurrent method to solve root LP
-    model.set(GRB_DoubleParam_MIPGap, 0);  // force gurobi to prove optimality
+    model->set(GRB_DoubleParam_TimeLimit, 3600.); // 1 hour
+    //model->set(GRB_IntParam_Threads, 10); // limit to 10 threads
+    model->set(GRB_DoubleParam_NodefileStart, 10); // 10 GB
+    model->set(GRB_IntParam_Method, 3);  // use concurrent method to solve root LP
+    model->set(GRB_DoubleParam_MIPGap, 0);  // force gurobi to prove optimality
 
     //provide IP warm start 
     if(ls_ok)
-      for (int i = 0; i < nr_nodes; ++i)
-      {
-        for (int j = 0; j < nr_nodes; ++j)
-          if (IS_X(i, j))
-            X_V(i, j).set(GRB_DoubleAttr_Start, 0);
-
-        if (IS_X(i, heuristicSolution[i]))
-          X_V(i, heuristicSolution[i]).set(GRB_DoubleAttr_Start, 1);
-      }
+      set_hess_start(model, p, heuristicSolution);
 
     // calculate overtly
     int max_pv = population[0];
@@ -245,78 +350,450 @@ int main(int argc, char *argv[])
       max_pv = max(max_pv, pv);
 
     // free population and w
-    if(!cb) dealloc_vec(population, "population");
-    dealloc_vec(w, "w");
+    if(!keep_data)
+    {
+      if(!cb) dealloc_vec(population, "population");
+      dealloc_vec(w, "w");
+    }
 
-    //optimize the model
-    auto IP_start = chrono::steady_clock::now();
+    function<bool(vector<int>&, double&)> polish = nullptr;
+    if (rp.boundary_moves > 0)
+      polish = [&](vector<int>& assignment, double& UB)
+      {
+        return BoundaryMoveSearch(g, w, population, L, U, arg_model != "hess", static_cast<long>(rp.boundary_moves) * nr_nodes, assignment, UB);
+      };
+    optimize_and_report(rp, label, model, p, cb, nr_nodes, max_pv, U, start, solution, polish);
+    solved = true;
+  }
+  catch (GRBException e) {
+    printf("Error code = %d\n", e.getErrorCode());
+    printf("%s\n", e.getMessage().c_str());
+  }
+  catch (const char* msg) {
+    printf("Exception with message : %s\n", msg);
+  }
+  catch (...) {
+    printf("Exception during optimization\n");
+  }
 
-    model.optimize();
+  ffprintf(rp.output, "\n");
+  if (st && solved)
+  {
+    st->env = env; st->model = model; st->cb = cb;
+    st->solution = solution;
+  }
+  else
+  {
+    delete cb; delete model; delete env;
+  }
+}
 
-    chrono::duration<double> IP_duration = chrono::steady_clock::now() - IP_start;
-    ffprintf(rp.output, "%.2lf, ", IP_duration.count());
-    printf("IP duration time: %lf seconds\n", IP_duration.count());
-    chrono::duration<double> duration = chrono::steady_clock::now() - start;
-    printf("Total time elapsed: %lf seconds\n", duration.count());
-    ffprintf(rp.output, "%.2lf, ", duration.count());
-    if (cb)
+// one instance : heuristics, Lagrangian, fixings and the IP of every model, one CSV row per model goes to rp.output
+// the phases before the IP are shared : one Lagrangian for hess and one exploiting contiguity for the other models,
+// HessHeuristic and LocalSearch once, ContiguityHeuristic once for the contiguity models
+// with keep_data false g, w and population are released as soon as the last model does not need them
+// warm_start (optional) : multipliers of the previous instance, replaced by the ones of this instance
+// st (optional, single model) : keeps the model for re-optimization
+static void solve_instance(const run_params& rp, const vector<string>& models, const char* label, graph*& g, vector<vector<double>>& w,
+  vector<int>& population, int L, int U, int k, bool ralg_hot_start, const char* ralg_hot_start_fname, bool keep_data,
+  vector<double>* warm_start, reopt_state* st)
+{
+  int nr_nodes = g->nr_nodes;
+  bool need_hess = find(models.begin(), models.end(), "hess") != models.end();
+  bool need_contiguity = !need_hess || models.size() > 1;
+  typedef chrono::duration<double> seconds;
+
+  // heuristics, next to the Lagrangian with concurrent 1 : link[0] gets the hess upper bounds (HessHeuristic,
+  // LocalSearch), link[1] the contiguity one, and HessHeuristic may start from the centers of the Lagrangian
+  lagrange_link link[2];
+  lagrange_link& seed_link = link[need_hess ? 0 : 1];
+  int maxIterations = 10;   // 10 iterations is often sufficient
+  double heuristic_UB = MYINFINITY, LS_UB = MYINFINITY, contiguity_UB = MYINFINITY;
+  seconds heuristic_duration(0.), LS_duration(0.), contiguity_duration(0.);
+  vector<int> heuristicSolution, contiguitySolution;
+  bool ls_ok = false;
+  promise<void> ls_done;
+  auto heuristics = [&]()
+  {
+    vector<int> last_seed;
+    auto seed = [&](vector<int>& centers)
+    {
+      {
+        lock_guard<mutex> lock(seed_link.mutex);
+        centers = seed_link.centers;
+      }
+      if (centers.empty() || centers == last_seed)
+        return false;
+      last_seed = centers;
+      return true;
+    };
+    auto publish = [&link](double ub) { link[0].publish(ub); };
+
+    // run a heuristic
+    double UB = MYINFINITY;
+    auto heuristic_start = chrono::steady_clock::now();
+    // the multilevel heuristic runs HessHeuristic and LocalSearch on the coarsest graph, both run here if it fails
+    bool multilevel_ok = rp.multilevel > 0 &&
+      MultilevelHeuristic(g, w, population, L, U, k, rp.multilevel, maxIterations, heuristicSolution, UB, rp.ls_threads);
+    if (multilevel_ok)
+    {
+      publish(UB);
+      printf("Best solution of the multilevel heuristic is %.2lf\n", UB);
+    }
+    else
     {
-      printf("Number of callbacks: %d\n", cb->numCallbacks);
-      printf("Time in callbacks: %lf seconds\n", cb->callbackTime);
-      printf("Number of lazy constraints generated: %d\n", cb->numLazyCuts);
-      ffprintf(rp.output, "%d, %.2lf, %d, ", cb->numCallbacks, cb->callbackTime, cb->numLazyCuts);
-      delete cb;
-    } else ffprintf(rp.output, "n/a, n/a, n/a, ");
+      heuristicSolution = HessHeuristic(g, w, population, L, U, k, UB, maxIterations, false, publish,
+        rp.concurrent ? function<bool(vector<int>&)>(seed) : nullptr);
+      printf("Best solution after %d of HessHeuristic is %.2lf\n", maxIterations, UB);
+    }
+    heuristic_duration = chrono::steady_clock::now() - heuristic_start;
+    heuristic_UB = UB;
 
-    ffprintf(rp.output, "%.2lf, ", static_cast<double>(max_pv) / static_cast<double>(U));
+    // run local search
+    auto LS_start = chrono::steady_clock::now();
+    ls_ok = multilevel_ok || LocalSearch(g, w, population, L, U, k, heuristicSolution, UB, publish, rp.ls_threads);
+    printf("Best solution after local search is %.2lf\n", UB);
 
-    if (model.get(GRB_IntAttr_Status) == 3) // infeasible
-      ffprintf(rp.output, "infeasible, , , ");
-    else {
+    // polish the LocalSearch districts with boundary moves, the centers may change
+    if (ls_ok && rp.boundary_moves > 0 && BoundaryMoveSearch(g, w, population, L, U, false, static_cast<long>(rp.boundary_moves) * nr_nodes, heuristicSolution, UB))
+    {
+      publish(UB);
+      printf("Best solution after boundary moves is %.2lf\n", UB);
+    }
+    LS_duration = chrono::steady_clock::now() - LS_start;
+    LS_UB = UB;
+    ls_done.set_value();
+
+    // solve contiguity-constrained problem, restricted to centers from heuristicSolution
+    contiguitySolution = heuristicSolution;
+    contiguity_UB = LS_UB;
+    if (need_contiguity && ls_ok)
+    {
+      contiguity_UB = MYINFINITY;
+      auto contiguity_start = chrono::steady_clock::now();
+      // region growing from the same centers, the SHIR restricted MIP if it finds no balanced partition
+      if (rp.contiguity_heuristic == "mip" || !NativeContiguityHeuristic(g, w, population, L, U, contiguitySolution, contiguity_UB))
+        ContiguityHeuristic(contiguitySolution, g, w, population, L, U, k, contiguity_UB, "shir"); // arg_model);
+      if (rp.boundary_moves > 0 && contiguity_UB < MYINFINITY)
+        BoundaryMoveSearch(g, w, population, L, U, true, static_cast<long>(rp.boundary_moves) * nr_nodes, contiguitySolution, contiguity_UB);
+      contiguity_duration = chrono::steady_clock::now() - contiguity_start;
+      link[1].publish(contiguity_UB);
+    }
+  };
+  thread heuristics_thread;
+  if (rp.concurrent)
+    heuristics_thread = thread(heuristics);
+  else
+    heuristics();
+
+  // apply Lagrangian, variant 0 for hess, variant 1 exploits contiguity
+  // LB1 of a variant is turned into fixings right away (once its UB is final), only F0/F1 are kept
+  double LB[2] = {0., 0.};
+  seconds lagrange_duration[2] = {seconds(0.), seconds(0.)};
+  double perc_var_fixed[2] = {0., 0.};
+  vector<vector<bool>> F0[2], F1[2];
+  for (int variant = 0; variant < 2; ++variant)
+  {
+    if (variant == 0 ? !need_hess : !need_contiguity)
+      continue;
+    run_params rpv = rp; // the hot start dump is named after the instance and the model, the checkpoint after the model
+    rpv.label = label;
+    rpv.model = variant == 0 ? string("hess") : *find_if(models.begin(), models.end(), [](const string& m) { return m != "hess"; });
+    if (!rpv.ralg_checkpoint.empty())
+      rpv.ralg_checkpoint += "_" + rpv.model;
+    vector< vector<double> > LB1(nr_nodes, vector<double>(nr_nodes, -MYINFINITY)); // LB1[i][j] is a lower bound on problem objective if we fix x[i][j] = 1
+    vector<double> LB0(nr_nodes, -MYINFINITY); // LB0[j] is a lower bound on problem objective if we fix x[j][j] = 0
+    auto lagrange_start = chrono::steady_clock::now();
+    LB[variant] = solveLagrangian(g, w, population, L, U, k, LB1, LB0, ralg_hot_start, ralg_hot_start_fname, rpv, variant == 1, warm_start,
+      rp.concurrent ? &link[variant] : nullptr); // lower bound on problem objective, coming from lagrangian
+    lagrange_duration[variant] = chrono::steady_clock::now() - lagrange_start;
+
+    // determine which variables can be fixed
+    if (variant == 0)
+      ls_done.get_future().wait();
+    else if (heuristics_thread.joinable())
+      heuristics_thread.join();
+    perc_var_fixed[variant] = compute_fixings(LB1, LB0, variant == 0 ? LS_UB : contiguity_UB, k, F0[variant], F1[variant]);
+    // LB1 is not used anymore, release memory
+    dealloc_vec(LB1, "LB1");
+    dealloc_vec(LB0, "LB0");
+  }
+  if (heuristics_thread.joinable())
+    heuristics_thread.join();
 
-      double objbound = model.get(GRB_DoubleAttr_ObjBound);
+  auto dump_maybe_inf = [&rp](double val) { if (myabs(val-MYINFINITY) <= 1.) ffprintf(rp.output, "infinity, "); else ffprintf(rp.output, "%.2lf, ", val); };
 
-      // no incumbent solution was found, these values do no make sense
-      if (model.get(GRB_IntAttr_SolCount) == 0)
-        ffprintf(rp.output, "?, ?, ");
-      else
-      {
-        double objval = model.get(GRB_DoubleAttr_ObjVal);
-        double mipgap = model.get(GRB_DoubleAttr_MIPGap)*100.;
-        ffprintf(rp.output, "%.2lf, %.2lf, ", objval, mipgap);
-      }
+  for (size_t m = 0; m < models.size(); ++m)
+  {
+    run_params rpm = rp;
+    rpm.model = models[m];
+    int variant = (models[m] == "hess") ? 0 : 1;
+    dump_args(rpm, label, models[m].c_str(), nr_nodes, k, L, U);
+    ffprintf(rp.output, "%.2lf, %.2lf, ", LB[variant], lagrange_duration[variant].count());
+    dump_maybe_inf(heuristic_UB);
+    ffprintf(rp.output, "%.2lf, ", heuristic_duration.count());
+    dump_maybe_inf(LS_UB);
+    ffprintf(rp.output, "%.2lf, ", LS_duration.count());
+    if (variant == 1 && ls_ok)
+    {
+      dump_maybe_inf(contiguity_UB);
+      ffprintf(rp.output, "%.2lf, ", contiguity_duration.count());
+    } else ffprintf(rp.output, "n/a, n/a, ");
+    ffprintf(rp.output, "%.2lf, ", perc_var_fixed[variant]);
+
+    // total time as if the model ran alone : its own Lagrangian and the shared heuristics, side by side with concurrent 1
+    seconds heuristics_duration = heuristic_duration + LS_duration + (variant == 1 ? contiguity_duration : seconds(0.));
+    seconds preprocessing = rp.concurrent ? max(lagrange_duration[variant], heuristics_duration) : lagrange_duration[variant] + heuristics_duration;
+    auto start = chrono::steady_clock::now() - chrono::duration_cast<chrono::steady_clock::duration>(preprocessing);
+    bool last = (m + 1 == models.size());
+    solve_model(rpm, label, g, w, population, L, U, k, F0[variant], F1[variant], variant == 0 ? heuristicSolution : contiguitySolution,
+      ls_ok, keep_data || !last, start, st);
+  }
+}
+
+// re-optimizes the model of the previous instance in place for a new population (same graph, k and model),
+// returns false without writing to rp.output if the instance needs the full solve_instance :
+// lcut (its fixings depend on U), no previous solution, the previous partition violates the new L/U,
+// or a fixing of the model is not confirmed by the warm Lagrangian with the previous partition as upper bound
+static bool reoptimize_instance(const run_params& rp, const char* label, reopt_state& st, graph* g, vector<vector<double>>& w,
+  vector<int>& population, int L, int U, int k, vector<double>& warm_start)
+{
+  if (!st.model || st.solution.empty() || warm_start.empty() || rp.model == "lcut")
+    return false;
+  int nr_nodes = g->nr_nodes;
+  auto start = chrono::steady_clock::now();
 
-      ffprintf(rp.output, "%.2lf, ", objbound);
+  // the previous partition on the new data : contiguity is unchanged, the populations may leave [L, U]
+  vector<long> district_pop(nr_nodes, 0L);
+  double UB = 0.;
+  for (int i = 0; i < nr_nodes; ++i)
+  {
+    if (st.solution[i] < 0)
+      return false;
+    district_pop[st.solution[i]] += population[i];
+    UB += w[i][st.solution[i]];
+  }
+  for (int j = 0; j < nr_nodes; ++j)
+    if (st.solution[j] == j && (district_pop[j] < L || district_pop[j] > U))
+    {
+      printf("Re-optimization : district of %d has population %ld out of [%d, %d], full solve\n", j, district_pop[j], L, U);
+      return false;
     }
+  printf("Re-optimization : previous partition costs %.2lf\n", UB);
 
-    long nodecount = static_cast<long>(model.get(GRB_DoubleAttr_NodeCount));
-    ffprintf(rp.output, "%ld, ", nodecount);
+  // a short Lagrangian from the previous multipliers, as for a hot start
+  vector< vector<double> > LB1(nr_nodes, vector<double>(nr_nodes, -MYINFINITY));
+  vector<double> LB0(nr_nodes, -MYINFINITY);
+  auto lagrange_start = chrono::steady_clock::now();
+  run_params rpv = rp; // the hot start dump and the checkpoint are named as in solve_instance
+  rpv.label = label;
+  if (!rpv.ralg_checkpoint.empty())
+    rpv.ralg_checkpoint += "_" + rpv.model;
+  double LB = solveLagrangian(g, w, population, L, U, k, LB1, LB0, true, nullptr, rpv, rp.model != "hess", &warm_start);
+  chrono::duration<double> lagrange_duration = chrono::steady_clock::now() - lagrange_start;
 
-    if(model.get(GRB_IntAttr_SolCount) > 0)
-      ffprintf(rp.output, "Y");
-    else
-      ffprintf(rp.output, "N");
+  // the fixings of the model must still hold
+  vector<vector<bool>> F0, F1;
+  compute_fixings(LB1, LB0, UB, k, F0, F1);
+  int nr_lost = 0;
+  for (int i = 0; i < nr_nodes; ++i)
+    for (int j = 0; j < nr_nodes; ++j)
+      if ((st.p.F0[i][j] && !F0[i][j]) || (st.p.F1[i][j] && !F1[i][j]))
+        nr_lost++;
+  if (nr_lost > 0)
+  {
+    printf("Re-optimization : %d fixings of the model are not confirmed, full solve\n", nr_lost);
+    return false;
+  }
 
-    if (model.get(GRB_IntAttr_Status) != 3) {
-      vector<int> sol;
-      translate_solution(p, sol, nr_nodes);
-      string soln_fn = string(rp.state) + "_" + arg_model + ".sol";
-      printf_solution(sol, soln_fn.c_str());
-    }
+  dump_args(rp, label, rp.model.c_str(), nr_nodes, k, L, U);
+  ffprintf(rp.output, "%.2lf, %.2lf, ", LB, lagrange_duration.count());
+  ffprintf(rp.output, "%.2lf, 0.00, n/a, n/a, n/a, n/a, ", UB); // the previous partition stands for the heuristics
+  int nr_unfixed = 0;
+  for (int i = 0; i < nr_nodes; ++i)
+    for (int j = 0; j < nr_nodes; ++j)
+      if (!st.p.F0[i][j] && !st.p.F1[i][j])
+        nr_unfixed++;
+  ffprintf(rp.output, "%.2lf, ", (double)(nr_nodes*nr_nodes - nr_unfixed) / (nr_nodes*nr_nodes));
 
+  bool solved = false;
+  vector<int> solution;
+  try
+  {
+    update_hess_population(st.model, st.p, w, population, L, U);
+    if (st.cb)
+    {
+      st.cb->set_population(population);
+      st.cb->refresh(st.model, L, U);
+    }
+    set_hess_start(st.model, st.p, st.solution);
+    int max_pv = population[0];
+    for (int pv : population)
+      max_pv = max(max_pv, pv);
+    optimize_and_report(rp, label, st.model, st.p, st.cb, nr_nodes, max_pv, U, start, solution);
+    solved = true;
   }
   catch (GRBException e) {
     printf("Error code = %d\n", e.getErrorCode());
     printf("%s\n", e.getMessage().c_str());
   }
-  catch (const char* msg) {
-    printf("Exception with message : %s\n", msg);
-  }
   catch (...) {
     printf("Exception during optimization\n");
   }
-
   ffprintf(rp.output, "\n");
+  if (solved)
+    st.solution = solution;
+  else
+    st.clear(); // the next instance builds a new model
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  printf("Districting, build %s\n", gitversion);
+  if (argc < 2) {
+    printf("Usage: %s <config> [state [ralg_hot_start]]\n\
+  Available models:\n\
+  \thess\t\tHess model\n\
+  \tshir\t\tHess model with SHIR\n\
+  \tmcf\t\tHess model with MCF\n\
+  \tcut\t\tHess model with CUT\n\
+  \tlcut\t\tHess model with LCUT\n\
+  \tall\t\tall of the above, a list such as hess,cut also works\n\
+  \tcg\t\tcolumn generation over contiguous districts (price-and-branch)\n", argv[0]);
+    return 0;
+  }
+
+  // parse config
+  run_params rp;
+  rp = read_config(argv[1], (argc>2 ? argv[2] : ""), (argc>3 ? argv[3] : ""));
+  bool ralg_hot_start = !rp.ralg_hot_start.empty();
+  const char* ralg_hot_start_fname = (rp.ralg_hot_start.empty() ? nullptr : rp.ralg_hot_start.c_str());
+
+  // batch mode : the instances share graph and distances, only the population changes
+  vector<string> population_files;
+  if (!rp.population_list.empty() && read_population_list(rp.population_list.c_str(), population_files))
+    return 1; // failure
+  bool batch = !population_files.empty();
+
+  // read inputs
+  graph* g = nullptr;
+  vector<vector<int> > dist;
+  vector<int> population;
+  if (read_input_data(rp.dimacs_file.c_str(), rp.distance_file.c_str(), rp.population_file.c_str(), g, dist, population))
+    return 1; // failure
+
+  int k = (rp.k == 0) ? g->get_k() : rp.k;
+
+  vector<string> models = model_list(rp.model);
+  if (models.empty())
+  {
+    printf("ERROR: No model given\n");
+    exit(1);
+  }
+  for (const string& m : models)
+    if (m != "hess" && m != "shir" && m != "mcf" && m != "cut" && m != "lcut" && m != "cg")
+    {
+      printf("ERROR: Unknown model : %s\n", m.c_str());
+      exit(1);
+    }
+  // input errors are reported on the row of the (first) instance
+  auto fail = [&](const char* msg) {
+    int L = rp.L; int U = rp.U;
+    if (L == 0 || U == 0)
+      calculate_UL(population, k, &L, &U);
+    dump_args(rp, rp.state, rp.model.c_str(), g->nr_nodes, k, L, U);
+    ffprintf(rp.output, "%s\n", msg);
+    fclose(rp.output);
+    return 1;
+  };
+
+  g->connect(dist);
+
+  // check connectivity
+  if (!g->is_connected())
+  {
+    printf("Problem is infeasible (not connected!)\n");
+    return fail("disconnected");
+  }
+
+  if (g->nr_nodes <= 0)
+  {
+    printf("empty graph\n");
+    return fail("empty graph");
+  }
+
+  if (dist.size() != g->nr_nodes || population.size() != g->nr_nodes)
+  {
+    printf("dist/population size != n, expected %d\n", g->nr_nodes);
+    return fail("bad input data");
+  }
+
+  int nr_nodes = g->nr_nodes;
+  vector<vector<double>> w; // this is the weight matrix in the objective function
+  vector<double> warm_start; // best multipliers of the previous instance in batch mode
+  vector<int> prev_population;
+  bool reopt = batch && rp.reoptimize;
+  if (reopt && models.size() > 1)
+  {
+    printf("reoptimize needs a single model, ignored\n");
+    reopt = false;
+  }
+  reopt_state st;
+  int nr_instances = batch ? population_files.size() : 1;
+  for (int inst = 0; inst < nr_instances; ++inst)
+  {
+    string label = rp.state;
+    if (batch)
+    {
+      prev_population = population;
+      if (read_population(population_files[inst].c_str(), nr_nodes, population))
+      {
+        printf("Skipping %s\n", population_files[inst].c_str());
+        continue;
+      }
+      // AL_07.population -> AL_07 in the state column
+      label = population_files[inst];
+      size_t slash = label.find_last_of('/');
+      if (slash != string::npos)
+        label = label.substr(slash + 1);
+      label = label.substr(0, label.find('.'));
+      printf("\nInstance %d of %d : %s\n", inst + 1, nr_instances, population_files[inst].c_str());
+
+      // alpha_i is paid for vertex i and scales with p_i like row i of w, lambda and upsilon are per person
+      if (!warm_start.empty())
+        for (int i = 0; i < nr_nodes; ++i)
+          if (prev_population[i] > 0)
+            warm_start[i] *= static_cast<double>(population[i]) / prev_population[i];
+    }
+
+    int L = rp.L; int U = rp.U;
+    if (L == 0 || U == 0)
+      calculate_UL(population, k, &L, &U);
+
+    long total_pop = 0L;
+    for (int p : population)
+      total_pop += p;
+    printf("Model input: total population = %ld\n", total_pop);
+
+    // set objective function coefficients, the rows of w follow p_i, in batch mode w is refilled in place
+    w.resize(nr_nodes);
+    for (int i = 0; i < nr_nodes; i++)
+    {
+      w[i].resize(nr_nodes);
+      for (int j = 0; j < nr_nodes; j++)
+        w[i][j] = get_objective_coefficient(dist, population, i, j);
+    }
+
+    // dist is not used anymore
+    if (!batch)
+      dealloc_vec(dist, "dist");
+
+    if (!reopt || !reoptimize_instance(rp, label.c_str(), st, g, w, population, L, U, k, warm_start))
+      solve_instance(rp, models, label.c_str(), g, w, population, L, U, k, ralg_hot_start, ralg_hot_start_fname, batch, batch ? &warm_start : nullptr,
+        reopt ? &st : nullptr);
+  }
+
   fclose(rp.output);
   if(g) delete g;
   return 0;
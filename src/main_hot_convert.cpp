@@ -0,0 +1,71 @@
+// converts hot start files between the text format of older versions and the binary format
+#include <cstdio>
+#include <vector>
+#include <string>
+#include "graph.h"
+#include "io.h"
+
+using namespace std;
+extern const char* gitversion;
+
+int main(int argc, char* argv[])
+{
+  printf("Districting, build %s\n", gitversion);
+  if(argc < 3)
+  {
+    printf("Convert a ralg hot start between text (.hot/.ralg_hot of older versions) and binary\n");
+    printf("Usage: %s <input> <output> [config [state]]\n", argv[0]);
+    printf("A text input is written as binary, stamped with the instance hash of the config if given.\n");
+    printf("A binary input is written as text.\n");
+    return 0;
+  }
+
+  vector<double> x;
+  double bound;
+  uint64_t hash;
+  bool is_binary;
+  if(load_ralg_hot_start(argv[1], x, bound, hash, is_binary))
+  {
+    printf("Cannot read %s!\n", argv[1]);
+    return 1;
+  }
+  int dim = x.size();
+
+  if(is_binary)
+  {
+    dump_ralg_hot_start_text(argv[2], x.data(), dim, bound);
+    printf("%d multipliers, bound %lf, hash %016llx written as text to %s\n", dim, bound, static_cast<unsigned long long>(hash), argv[2]);
+    return 0;
+  }
+
+  hash = 0;
+  if(argc > 3)
+  {
+    // the instance as districting and ralg_hot_start see it
+    run_params rp = read_config(argv[3], (argc > 4 ? argv[4] : ""), "");
+    graph* g = nullptr;
+    vector<vector<int> > dist;
+    vector<int> population;
+    if(read_input_data(rp.dimacs_file.c_str(), rp.distance_file.c_str(), rp.population_file.c_str(), g, dist, population))
+      return 1;
+    int k = (rp.k == 0) ? g->get_k() : rp.k;
+    int L = rp.L, U = rp.U;
+    if(L == 0 || U == 0)
+      calculate_UL(population, k, &L, &U);
+    g->connect(dist);
+    if(dim != 3 * static_cast<int>(g->nr_nodes))
+    {
+      printf("%s has %d multipliers, the instance has n = %d (expected %d)!\n", argv[1], dim, g->nr_nodes, 3 * g->nr_nodes);
+      delete g;
+      return 1;
+    }
+    hash = instance_hash(g, population, k, L, U);
+    delete g;
+  }
+  else
+    printf("No config, the output has no instance hash\n");
+
+  dump_ralg_hot_start_fname(argv[2], x.data(), dim, bound, hash);
+  printf("%d multipliers, bound %lf, hash %016llx written as binary to %s\n", dim, bound, static_cast<unsigned long long>(hash), argv[2]);
+  return 0;
+}
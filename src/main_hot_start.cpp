@@ -50,53 +50,61 @@ int main(int argc, char *argv[])
   g->connect(dist);
 
   int nr_nodes = g->nr_nodes;
-  // set objective function coefficients
-  vector<vector<double>> w(nr_nodes, vector<double>(nr_nodes)); // this is the weight matrix in the objective function
-  for (int i = 0; i < nr_nodes; i++)
-    for (int j = 0; j < nr_nodes; j++)
-      w[i][j] = get_objective_coefficient(dist, population, i, j);
-
-
-  // determine which variables can be fixed
-  vector<vector<bool>> F0(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_0
-  vector<vector<bool>> F1(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_1
-
   auto start = chrono::steady_clock::now();
 
   try
   {
-    // initialize environment and create an empty model
+    // initialize environment
     GRBEnv env = GRBEnv();
-    GRBModel model = GRBModel(env);
-
-    // get incumbent solution using centers from lagrangian
-    hess_params p;
-    p = build_hess_special(&model, g, w, population, L, U, k); // constraints are well-organized
-
-    // relax the model
-    //model.set(GRB_IntParam_NodeCount, 1);
-    // UPD: build hess special is already relaxed
-
-    //model.set(GRB_DoubleParam_TimeLimit, 36000.); // 10 hour
-    //model.set(GRB_IntParam_Threads, 10); // limit to 10 threads
-    //model.set(GRB_DoubleParam_NodefileStart, 10); // 10 GB
-    model.set(GRB_IntParam_Method, 2);  // use barrier
-    model.set(GRB_IntParam_Crossover, 0); // disable crossover to get internal point
-
-    model.optimize();
+    std::vector<double> x_val(3*nr_nodes);
+    double opt;
 
-    double opt = model.get(GRB_DoubleAttr_ObjVal);
-    GRBConstr* c = model.getConstrs();
+    if(rp.hot_start_nearest > 0)
+    {
+      // columns and rows (e) are generated, the n^2 model is never built
+      opt = solve_hess_special_cg(env, g, dist, population, L, U, k, rp.hot_start_nearest, x_val);
+    }
+    else
+    {
+      GRBModel model = GRBModel(env);
+
+      // set objective function coefficients
+      vector<vector<double>> w(nr_nodes, vector<double>(nr_nodes)); // this is the weight matrix in the objective function
+      for (int i = 0; i < nr_nodes; i++)
+        for (int j = 0; j < nr_nodes; j++)
+          w[i][j] = get_objective_coefficient(dist, population, i, j);
+
+      // get incumbent solution using centers from lagrangian
+      hess_params p;
+      p = build_hess_special(&model, g, w, population, L, U, k); // constraints are well-organized
+
+      // relax the model
+      //model.set(GRB_IntParam_NodeCount, 1);
+      // UPD: build hess special is already relaxed
+
+      //model.set(GRB_DoubleParam_TimeLimit, 36000.); // 10 hour
+      //model.set(GRB_IntParam_Threads, 10); // limit to 10 threads
+      //model.set(GRB_DoubleParam_NodefileStart, 10); // 10 GB
+      model.set(GRB_IntParam_Method, 2);  // use barrier
+      model.set(GRB_IntParam_Crossover, 0); // disable crossover to get internal point
+
+      model.optimize();
+
+      opt = model.get(GRB_DoubleAttr_ObjVal);
+      GRBConstr* c = model.getConstrs();
+      for(int i = 0; i < 3*nr_nodes; ++i)
+        x_val[i] = c[i].get(GRB_DoubleAttr_Pi);
+      delete[] c;
+    }
     // extra memory usage, but should not matter
-    std::vector<double> x_val(3*nr_nodes);
     for(int i = 0; i < 3*nr_nodes; ++i)
     {
       double coef = 1;
       if(i >= nr_nodes) coef = L;
       if(i >= 2*nr_nodes) coef = U;
-      x_val[i] = coef * c[i].get(GRB_DoubleAttr_Pi);
+      x_val[i] *= coef;
     }
-    dump_ralg_hot_start_fname(ralg_hot_start_fname, x_val.data(), 3*nr_nodes, opt);
+    dump_ralg_hot_start_fname(ralg_hot_start_fname, x_val.data(), 3*nr_nodes, opt, instance_hash(g, population, k, L, U));
 
     chrono::duration<double> duration = chrono::steady_clock::now() - start;
     printf("Total time elapsed: %lf seconds\n", duration.count());
@@ -0,0 +1,109 @@
+// lifts a county-level ralg hot start to tract-level multipliers
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "io.h"
+
+using namespace std;
+extern const char* gitversion;
+
+// "<vertex> <geoid>" lines of a .hash file
+static bool scan_hash(vector<string>& geoid, const char* fname)
+{
+  FILE *f = fopen(fname, "r");
+  if(!f)
+  {
+    printf("Cannot open %s!\n", fname);
+    return false;
+  }
+  int v;
+  char data[1023];
+  while(fscanf(f, "%d %1000s ", &v, data) == 2)
+  {
+    if(v < 0)
+      continue;
+    if(v >= static_cast<int>(geoid.size()))
+      geoid.resize(v + 1);
+    geoid[v] = data;
+  }
+  fclose(f);
+  return true;
+}
+
+// a tract GEOID starts with the GEOID of its county (2 digits state, 3 digits county)
+static int make_map(const char* tract_hash, const char* county_hash, const char* outname)
+{
+  vector<string> tracts, counties;
+  if(!scan_hash(tracts, tract_hash) || !scan_hash(counties, county_hash))
+    return 1;
+  unordered_map<string, int> county_of;
+  for(int c = 0; c < static_cast<int>(counties.size()); ++c)
+    county_of[counties[c]] = c;
+
+  FILE* out = fopen(outname, "w");
+  if(!out)
+  {
+    printf("Cannot open %s!\n", outname);
+    return 1;
+  }
+  for(int t = 0; t < static_cast<int>(tracts.size()); ++t)
+  {
+    auto it = county_of.find(tracts[t].substr(0, 5));
+    if(it == county_of.end())
+    {
+      printf("Tract %d (%s) has no county in %s!\n", t, tracts[t].c_str(), county_hash);
+      fclose(out);
+      return 1;
+    }
+    fprintf(out, "%d %d\n", t, it->second);
+  }
+  fclose(out);
+  printf("%lu tracts mapped to %lu counties\n", tracts.size(), counties.size());
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  printf("Districting, build %s\n", gitversion);
+  if(argc == 5 && strcmp(argv[1], "map") == 0)
+    return make_map(argv[2], argv[3], argv[4]);
+  if(argc < 5)
+  {
+    printf("Lift a county-level ralg hot start to tracts\n");
+    printf("Usage: %s <county.hot> <tract_county.map> <tract.population> <output.hot>\n", argv[0]);
+    printf("       %s map <tract.hash> <county.hash> <tract_county.map>\n", argv[0]);
+    printf("The map has lines \"<tract> <county>\" (vertex indices). The output is a binary hot start with the county\n");
+    printf("bound and no instance hash (0), so only its dimension is checked when a run reads it\n");
+    return 0;
+  }
+
+  vector<int> county;
+  // the population file is read for the tracts listed in the map
+  FILE* f = fopen(argv[2], "r");
+  if(!f)
+  {
+    printf("Cannot open %s!\n", argv[2]);
+    return 1;
+  }
+  int t, c, n = 0;
+  while(fscanf(f, "%d %d ", &t, &c) == 2)
+    n++;
+  fclose(f);
+  if(read_tract_county_map(argv[2], n, county) < 0)
+    return 1;
+
+  vector<int> population;
+  if(read_population(argv[3], n, population))
+    return 1;
+
+  vector<double> x0(3*n);
+  double opt;
+  if(lift_ralg_hot_start(argv[1], county, population, x0.data(), &opt))
+    return 1;
+  // the tract graph is not read here, the output has no instance hash
+  dump_ralg_hot_start_fname(argv[4], x0.data(), 3*n, opt, 0);
+  printf("Lifted %d tracts to %s\n", n, argv[4]);
+  return 0;
+}
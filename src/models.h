@@ -2,6 +2,10 @@
 #define _MODELS_H
 
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include "common.h"
 #include "graph.h"
 #include "io.h"
@@ -16,8 +20,26 @@ double get_objective_coefficient(const vector<vector<int>>& dist, const vector<i
 
 // build hess model and return x variables
 hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, cvv& F0, cvv& F1);
+// hess model over the given centers only, x_ij for j in centers
+hess_params build_hess_restricted(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, const vector<int>& centers, int L, int U, int k);
 // constraints are organized in certain order to match Lagrangian
 hess_params build_hess_special(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k);
+// the same relaxation by column and row generation : the nearest vertices of every i, priced columns and violated (e) rows
+// pi gets the duals of the (b), (d) lower and (d) upper rows in the order of build_hess_special, returns the LP value
+double solve_hess_special_cg(GRBEnv& env, graph* g, const vector<vector<int>>& dist, const vector<int>& population, int L, int U, int k, int nearest, vector<double>& pi);
+// in-place update of a build_hess model to new population, L, U and w on the same graph with the same fixings
+// the population coefficients of the district rows, L and U of (d) and the objective are changed
+void update_hess_population(GRBModel* model, hess_params& p, const vector<vector<double> >& w, const vector<int>& population, int L, int U);
+// batch attribute access over the surviving variables p.x[0..NR_VAR(p))
+// assignment[i] = j sets x_ij = 1 and the rest of row i to 0, assignment[i] < 0 leaves row i undefined
+void set_hess_start(GRBModel* model, const hess_params& p, const vector<int>& assignment);
+// branch priority for the x_jj variables
+void set_center_priority(GRBModel* model, const hess_params& p, int priority);
+// objective x_ij -> w[i][j]
+void set_hess_obj(GRBModel* model, const hess_params& p, const vector<vector<double> >& w);
+// assignment[i] = j such that x_ij = 1 (variables or F1), -1 if none
+void values_to_assignment(const hess_params& p, const double* x, vector<int>& assignment);
+void get_hess_assignment(GRBModel* model, const hess_params& p, vector<int>& assignment);
 // add MCF constraints to model with hess variables x
 void build_shir(GRBModel* model, hess_params& p, graph* g);
 void build_mcf(GRBModel* model, hess_params& p, graph* g);
@@ -29,19 +51,30 @@ protected:
   double** x_val; // x values
   graph* g; // graph pointer
   int n; // g->nr_nodes
-  const vector<int> population;
+  vector<int> population;
+  vector<pair<int, int>> fixed_one; // (i,j) with F1[i][j]
 public:
   int numCallbacks; // number of callback calls
   double callbackTime; // cumulative time in callbacks
   int numLazyCuts;
-  HessCallback(hess_params& p_, graph* g_, const vector<int>& population_) : p(p_), g(g_), population(population_), numCallbacks(0), callbackTime(0.), numLazyCuts(0)
+  int numHeuristicSolutions; // solutions passed to setSolution
+  HessCallback(hess_params& p_, graph* g_, const vector<int>& population_) : p(p_), g(g_), population(population_), numCallbacks(0), callbackTime(0.), numLazyCuts(0),
+    numHeuristicSolutions(0)
 
   {
     n = g->nr_nodes;
     x_val = new double*[n];
     for (int i = 0; i < n; ++i)
       x_val[i] = new double[n];
+    for (int i = 0; i < n; ++i)
+      for (int j = 0; j < n; ++j)
+        if (p.F1[i][j])
+          fixed_one.push_back(make_pair(i, j));
   }
+  // population of an instance re-optimized in place (update_hess_population)
+  void set_population(const vector<int>& population_) { population = population_; }
+  // objective and L/U of a model changed in place, for callbacks that keep a copy of them
+  virtual void refresh(GRBModel*, int, int) {}
   virtual ~HessCallback()
   {
     for (int i = 0; i < n; ++i)
@@ -49,19 +82,26 @@ public:
     delete[] x_val;
   }
 protected:
-  void populate_x()
+  // x of the MIPSOL incumbent, or of the node relaxation (MIPNODE) with node_rel
+  void populate_x(bool node_rel = false)
   {
     for (int i = 0; i < n; ++i)
-      for (int j = 0; j < n; ++j)
-        if (IS_X(i, j))
-          x_val[i][j] = getSolution(X_V(i, j));
-        else if (p.F1[i][j]) x_val[i][j] = 1.; else x_val[i][j] = 0.;
+      fill(x_val[i], x_val[i] + n, 0.);
+    for (const auto& ij : fixed_one)
+      x_val[ij.first][ij.second] = 1.;
+    int nr_var = NR_VAR(p);
+    double* x = node_rel ? getNodeRel(p.x, nr_var) : getSolution(p.x, nr_var);
+    for (int v = 0; v < nr_var; ++v)
+      x_val[p.var_i[v]][p.var_j[v]] = x[v];
+    delete[] x;
   }
 };
 
 // @return callback for delete only
-HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population);
-HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U);
+// the callback also repairs the disconnected incumbents it rejects and rounds node relaxations into contiguous
+// districts within [L, U], improving ones go to setSolution
+HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int L, int U);
+HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int L, int U);
 //Lagrangian functions
 // input:
 //    g: graph pointer
@@ -80,22 +120,83 @@ HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector
 void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k, const vector<int>& population,
   const vector<vector<double>>& w, vector<vector<double>>& w_hat, vector<double>& W, double* grad, double& f_val, vector<bool>& currentCenters);
 
+// a Lagrangian running next to the heuristics : they publish upper bounds valid for it,
+// it publishes the centers of its most recent inner problem and stops early (ralg_stop_gap, ralg_stop_stall)
+struct lagrange_link
+{
+  std::atomic<double> UB;
+  std::mutex mutex; // guards centers
+  vector<int> centers; // empty until the first inner problem
+  lagrange_link() : UB(MYINFINITY) {}
+  // UB = min(UB, ub)
+  void publish(double ub)
+  {
+    double cur = UB.load();
+    while (ub < cur && !UB.compare_exchange_weak(cur, ub));
+  }
+};
+
+// LB1[i][j] : lower bound on objective if x_ij = 1
+// LB0[j]    : lower bound on objective if x_jj = 0
 double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k,
-  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity);
+  vector<vector<double>>& LB1, vector<double>& LB0, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity,
+  vector<double>* warm_start = nullptr, lagrange_link* link = nullptr);
+// warm_start : multipliers of a related instance (same n), used as x0 when non-empty, gets the best multipliers on return
+// link (optional) : see lagrange_link
+
+// the update_LB* functions touch only columns j_begin <= j < j_end (j_end = -1 : all), so disjoint ranges can run concurrently
+void update_LB0(const vector<double>& W, const vector<bool>& currentCenters, double f_val, vector<double>& LB0,
+  int j_begin = 0, int j_end = -1);
 
 void update_LB(const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1);
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, vector<double>& LB0, int j_begin = 0, int j_end = -1);
 
 void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1);
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, vector<double>& LB0, int j_begin = 0, int j_end = -1);
 
+// derive implied fixings from F0/F1 until fixpoint: rows with one option left, centers of fixed rows,
+// columns of centers fixed out, and the number of centers k
+// returns the number of new fixings to one
+int propagate_fixings(vector<vector<bool>>& F0, vector<vector<bool>>& F1, int k);
+
+// publish (optional) gets every improved UB, seed (optional) may replace the random centers of an iteration
 vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, double &UB, int maxIterations, bool do_cuts = false);
+  int L, int U, int k, double &UB, int maxIterations, bool do_cuts = false,
+  const function<void(double)>& publish = nullptr, const function<bool(vector<int>&)>& seed = nullptr);
 
 void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<vector<double> > &w, 
   const vector<int> &population, int L, int U, int k, double &UB, string arg_model);
 
+// contiguous districts grown from the centers of heuristicSolution (heuristic.cpp) : region growing by w(i, center)
+// with U admission, boundary moves for L/U, recentering; heuristicSolution and UB are replaced if a cheaper
+// partition within [L, U] is found, returns whether one was
+bool NativeContiguityHeuristic(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U,
+  vector<int>& heuristicSolution, double& UB);
+
+// simulated annealing over boundary moves (heuristic.cpp) : a vertex goes to the district of a neighbor if L/U hold
+// and, with contiguous, it is not an articulation point of its district (kept per district), else it is swapped
+// with that neighbor; the objective delta is w(i, new center) - w(i, old center), centers are re-optimized periodically
+// solution (vertex -> center) must be within [L, U], it and UB are replaced by a cheaper one, returns whether found
+bool BoundaryMoveSearch(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U,
+  bool contiguous, long nr_moves, vector<int>& solution, double& UB);
+
+// column generation over contiguous districts (cg.cpp) : set-partitioning master LP, columns priced per center by
+// region growing and, when that finds none, by a rooted connected subgraph MIP (single-commodity flow) whose bounds
+// give the Lagrangian bound z_LP + k min rc; x_ij with F0[i][j] is never priced, start (if complete) gives the first
+// columns; the master IP over the columns (price-and-branch, centers branched first) gets what is left of time_limit
+// returns the best objective (MYINFINITY if none), solution (vertex -> center), LB is -MYINFINITY without exact pricing
+double solve_district_cg(GRBEnv& env, graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U, int k,
+  cvv& F0, const vector<int>& start, double time_limit, vector<int>& solution, double& LB, int& nr_columns, long& nodecount);
+
+// multilevel heuristic (multilevel.cpp) : coarsens g by heavy-edge matching under a population cap down to
+// coarse_size vertices, runs HessHeuristic and LocalSearch there and projects the districts back level by level,
+// reassigning to the same centers when L/U are violated and refining with boundary moves
+// heuristicSolution and UB are replaced if a cheaper partition within [L, U] is found, returns whether one was
+bool MultilevelHeuristic(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U, int k,
+  int coarse_size, int maxIterations, vector<int>& heuristicSolution, double& UB, int ls_threads);
+
 bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, vector<int>&heuristicSolution, double &UB);
+  int L, int U, int k, vector<int>&heuristicSolution, double &UB, const function<void(double)>& publish = nullptr, int nr_threads = 1);
+// nr_threads restricted models evaluate swaps concurrently (0 : all cores), the first improving swap in the sequential order wins
 
 #endif
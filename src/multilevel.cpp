@@ -0,0 +1,235 @@
+// multilevel heuristic : heavy-edge coarsening with aggregated population, the heuristics on the coarsest graph,
+// projection level by level with a restricted assignment (if L/U are violated) and boundary-move refinement
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include "graph.h"
+#include "gurobi_c++.h"
+#include "models.h"
+
+using namespace std;
+
+const int MultilevelPopDivisor = 10;     // a coarse vertex holds at most U / MultilevelPopDivisor people
+const double MultilevelMinShrink = 0.95; // coarsening stops when a level keeps more of the vertices
+const long MultilevelMovesPerVertex = 50; // boundary moves of the refinement of a level
+const unsigned MultilevelSeed = 2021;
+
+// one level of the hierarchy, level 0 is the input graph
+struct ml_level
+{
+  graph* g;
+  vector<int> population;
+  vector<vector<int>> members; // input vertices of a vertex
+  vector<int> rep;             // input vertex standing for a vertex as a center
+  vector<int> rep_child;       // vertex of the next finer level with the same rep
+  vector<int> parent;          // vertex of the next coarser level
+  int max_pop;
+};
+
+// W[I][J] = sum of w[i][rep[J]] over the members i of I, the cost of I in the district of center J
+static void level_weights(const ml_level& lv, const vector<vector<double>>& w, vector<vector<double>>& W)
+{
+  int n = lv.g->nr_nodes;
+  W.assign(n, vector<double>(n, 0.));
+  for (int I = 0; I < n; ++I)
+    for (int J = 0; J < n; ++J)
+      for (int i : lv.members[I])
+        W[I][J] += w[i][lv.rep[J]];
+}
+
+// heavy-edge matching of lv under the population cap, returns the coarser level (g == nullptr if it would not shrink)
+static ml_level coarsen(ml_level& lv, const vector<vector<double>>& w, int cap, mt19937& rng)
+{
+  int n = lv.g->nr_nodes;
+  // sum of w[i][c] over the members i of I
+  auto cost = [&](int I, int c) {
+    double s = 0.;
+    for (int i : lv.members[I])
+      s += w[i][c];
+    return s;
+  };
+  vector<int> order(n);
+  for (int v = 0; v < n; ++v)
+    order[v] = v;
+  shuffle(order.begin(), order.end(), rng);
+  // light vertices first, they have the most room under the cap
+  stable_sort(order.begin(), order.end(), [&](int a, int b) { return lv.population[a] < lv.population[b]; });
+
+  ml_level c;
+  c.g = nullptr;
+  lv.parent.assign(n, -1);
+  for (int u : order)
+  {
+    if (lv.parent[u] >= 0)
+      continue;
+    // the merge costs the members of one side at the rep of the other
+    int best = -1, best_rep = lv.rep[u];
+    double best_cost = MYINFINITY;
+    for (int v : lv.g->nb(u))
+    {
+      if (lv.parent[v] >= 0 || lv.population[u] + lv.population[v] > cap)
+        continue;
+      double to_u = cost(v, lv.rep[u]), to_v = cost(u, lv.rep[v]);
+      if (mymin(to_u, to_v) < best_cost)
+      {
+        best_cost = mymin(to_u, to_v);
+        best = v;
+        best_rep = to_u <= to_v ? lv.rep[u] : lv.rep[v];
+      }
+    }
+    int id = c.rep.size();
+    lv.parent[u] = id;
+    c.members.push_back(lv.members[u]);
+    c.population.push_back(lv.population[u]);
+    c.rep.push_back(best_rep);
+    c.rep_child.push_back(best_rep == lv.rep[u] || best < 0 ? u : best);
+    if (best >= 0)
+    {
+      lv.parent[best] = id;
+      c.members[id].insert(c.members[id].end(), lv.members[best].begin(), lv.members[best].end());
+      c.population[id] += lv.population[best];
+    }
+  }
+  int nc = c.rep.size();
+  if (nc > MultilevelMinShrink * n)
+  {
+    lv.parent.clear();
+    return c;
+  }
+
+  c.g = new graph(nc);
+  for (int u = 0; u < n; ++u)
+    for (int v : lv.g->nb(u))
+      if (lv.parent[u] < lv.parent[v])
+        c.g->add_edge(lv.parent[u], lv.parent[v]);
+  c.max_pop = *max_element(c.population.begin(), c.population.end());
+  return c;
+}
+
+// optimal assignment to the centers of solution within [L, U], solution is replaced, returns whether found
+static bool restricted_assignment(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U, int k,
+  vector<int>& solution)
+{
+  vector<int> centers;
+  for (int i = 0; i < static_cast<int>(g->nr_nodes); ++i)
+    if (solution[i] == i)
+      centers.push_back(i);
+  if (static_cast<int>(centers.size()) != k)
+    return false;
+  try
+  {
+    GRBEnv env;
+    GRBModel model(env);
+    hess_params p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
+    for (int j : centers)
+      X_V(j, j).set(GRB_DoubleAttr_LB, 1);
+    model.set(GRB_DoubleParam_TimeLimit, 60.);
+    model.set(GRB_IntParam_OutputFlag, 0);
+    model.optimize();
+    if (model.get(GRB_IntAttr_SolCount) == 0)
+      return false;
+    get_hess_assignment(&model, p, solution);
+    return true;
+  }
+  catch (GRBException e) {
+    printf("Error code = %d\n", e.getErrorCode());
+    printf("%s\n", e.getMessage().c_str());
+  }
+  return false;
+}
+
+bool MultilevelHeuristic(graph* g, const vector<vector<double>>& w, const vector<int>& population, int L, int U, int k,
+  int coarse_size, int maxIterations, vector<int>& heuristicSolution, double& UB, int ls_threads)
+{
+  auto start = chrono::steady_clock::now();
+  int n = g->nr_nodes;
+  mt19937 rng(MultilevelSeed);
+  int cap = mymax(1, U / MultilevelPopDivisor);
+
+  vector<ml_level> levels(1);
+  levels[0].g = g;
+  levels[0].population = population;
+  levels[0].members.resize(n);
+  levels[0].rep.resize(n);
+  for (int i = 0; i < n; ++i)
+  {
+    levels[0].members[i] = {i};
+    levels[0].rep[i] = i;
+  }
+  levels[0].max_pop = *max_element(population.begin(), population.end());
+  while (static_cast<int>(levels.back().g->nr_nodes) > mymax(coarse_size, 2 * k))
+  {
+    ml_level c = coarsen(levels.back(), w, cap, rng);
+    if (!c.g)
+      break;
+    levels.push_back(move(c));
+  }
+  int top = levels.size() - 1;
+  printf("Multilevel : %d levels, n = %d -> %d, population cap %d\n", top, n, levels[top].g->nr_nodes, cap);
+
+  // a coarse vertex may overshoot a district by its population, the bounds of a level are widened by its largest vertex
+  auto level_L = [&](int l) { return l == 0 ? L : L - levels[l].max_pop; };
+  auto level_U = [&](int l) { return l == 0 ? U : U + levels[l].max_pop; };
+
+  bool found = false;
+  vector<int> solution;
+  vector<vector<double>> W;
+  if (top > 0)
+    level_weights(levels[top], w, W);
+  const vector<vector<double>>& Wtop = top > 0 ? W : w;
+  double ub = MYINFINITY;
+  solution = HessHeuristic(levels[top].g, Wtop, levels[top].population, level_L(top), level_U(top), k, ub, maxIterations);
+  if (ub < MYINFINITY)
+    found = LocalSearch(levels[top].g, Wtop, levels[top].population, level_L(top), level_U(top), k, solution, ub, nullptr, ls_threads);
+  printf("Multilevel : UB %.2lf on the coarsest level\n", ub);
+
+  for (int l = top - 1; found && l >= 0; --l)
+  {
+    const ml_level& lv = levels[l];
+    const ml_level& up = levels[l + 1];
+    int nl = lv.g->nr_nodes;
+    vector<int> projected(nl);
+    for (int v = 0; v < nl; ++v)
+      projected[v] = up.rep_child[solution[lv.parent[v]]];
+    solution.swap(projected);
+
+    if (l > 0)
+      level_weights(lv, w, W);
+    else
+      vector<vector<double>>().swap(W);
+    const vector<vector<double>>& Wl = l > 0 ? W : w;
+    int Ll = level_L(l), Ul = level_U(l);
+
+    // district populations carry over, only the bounds got tighter
+    vector<long> pop(nl, 0L);
+    for (int v = 0; v < nl; ++v)
+      pop[solution[v]] += lv.population[v];
+    bool balanced = true;
+    for (int v = 0; v < nl; ++v)
+      if (solution[v] == v && (pop[v] < Ll || pop[v] > Ul))
+        balanced = false;
+    if (!balanced && !restricted_assignment(lv.g, Wl, lv.population, Ll, Ul, k, solution))
+    {
+      printf("Multilevel : no assignment within [%d, %d] on level %d\n", Ll, Ul, l);
+      found = false;
+      break;
+    }
+    ub = 0.;
+    for (int v = 0; v < nl; ++v)
+      ub += Wl[v][solution[v]];
+    BoundaryMoveSearch(lv.g, Wl, lv.population, Ll, Ul, false, MultilevelMovesPerVertex * nl, solution, ub);
+    printf("Multilevel : UB %.2lf on level %d (n = %d)%s\n", ub, l, nl, balanced ? "" : ", reassigned");
+  }
+
+  for (int l = 1; l <= top; ++l)
+    delete levels[l].g;
+  chrono::duration<double> duration = chrono::steady_clock::now() - start;
+  printf("Multilevel heuristic : %s in %.2lf seconds\n", found ? "found" : "failed", duration.count());
+  if (!found || ub >= UB)
+    return false;
+  heuristicSolution = solution;
+  UB = ub;
+  return true;
+}
@@ -0,0 +1,268 @@
+#include "bundle.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+static double dot(unsigned int n, const double* x, const double* y)
+{
+  double s = 0.;
+  for(unsigned int i = 0; i < n; ++i)
+    s += x[i] * y[i];
+  return s;
+}
+
+// Euclidean projection onto the unit simplex
+static void project_simplex(std::vector<double>& y)
+{
+  std::vector<double> s(y);
+  std::sort(s.begin(), s.end(), [](double a, double b) { return a > b; });
+  double sum = 0., tau = 0.;
+  for(size_t i = 0; i < s.size(); ++i)
+  {
+    sum += s[i];
+    double t = (sum - 1.) / (i + 1);
+    if(s[i] - t > 0.)
+      tau = t;
+  }
+  for(double& v : y)
+    v = std::max(0., v - tau);
+}
+
+// min (1/2u) theta' Q theta + e' theta over the simplex, accelerated projected gradient
+// theta is the warm start on input, Q is m x m with leading dimension ld
+static void solve_master(unsigned int m, const std::vector<double>& Q, unsigned int ld, const std::vector<double>& e,
+  double u, std::vector<double>& theta)
+{
+  // Lipschitz constant of the gradient, largest eigenvalue of Q / u by power iteration
+  std::vector<double> p(m, 1.), q(m);
+  double lmax = 0.;
+  for(int it = 0; it < 30; ++it)
+  {
+    for(unsigned int i = 0; i < m; ++i)
+    {
+      q[i] = 0.;
+      for(unsigned int j = 0; j < m; ++j)
+        q[i] += Q[i*ld + j] * p[j];
+    }
+    double nq = sqrt(dot(m, q.data(), q.data()));
+    if(nq <= 0.)
+      break;
+    lmax = nq / sqrt(dot(m, p.data(), p.data()));
+    for(unsigned int i = 0; i < m; ++i)
+      p[i] = q[i] / nq;
+  }
+  double L = 1.1 * lmax / u + 1.e-12;
+
+  std::vector<double> y(theta), prev(theta), grad(m);
+  double t = 1.;
+  for(int it = 0; it < 1000; ++it)
+  {
+    for(unsigned int i = 0; i < m; ++i)
+    {
+      double s = 0.;
+      for(unsigned int j = 0; j < m; ++j)
+        s += Q[i*ld + j] * y[j];
+      grad[i] = s / u + e[i];
+    }
+    for(unsigned int i = 0; i < m; ++i)
+      theta[i] = y[i] - grad[i] / L;
+    project_simplex(theta);
+    double t_next = (1. + sqrt(1. + 4. * t * t)) / 2.;
+    double change = 0.;
+    for(unsigned int i = 0; i < m; ++i)
+    {
+      change = std::max(change, fabs(theta[i] - prev[i]));
+      y[i] = theta[i] + (t - 1.) / t_next * (theta[i] - prev[i]);
+    }
+    prev = theta;
+    t = t_next;
+    if(change < 1.e-12)
+      break;
+  }
+}
+
+double bundle(const bundle_options* opt,
+          std::function<bool (const double*, double&, double*)> cb_grad_and_func,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res,
+          bool is_min)
+{
+  // internally the concave function sign * f is maximized
+  const double sign = (is_min)?(-1.):(1.);
+  const unsigned int B = std::max(opt->bundle_max, 2u);
+  std::vector<double> xh(x0, x0 + DIMENSION); // stability center
+  std::vector<double> x(DIMENSION), d(DIMENSION), grad(DIMENSION);
+  std::vector<double> G((size_t)B * DIMENSION); // subgradients of the cuts, row-wise
+  std::vector<double> e(B);                       // linearization errors at the center
+  std::vector<double> Q((size_t)B * B);           // Q[i][j] = g_i' g_j
+  std::vector<double> theta;
+  unsigned int m = 0;
+
+  printf("Running proximal bundle, bundle size %u\n", B);
+  time_t t_started = time(NULL);
+
+  double f_val;
+  if(!cb_grad_and_func(xh.data(), f_val, grad.data()))
+  {
+    printf("grad failed, aborting\n");
+    return 0.;
+  }
+  double fh = sign * f_val;
+
+  // appends the cut (grad, err)
+  auto add_cut = [&](const double* g, double err)
+  {
+    double* gm = G.data() + (size_t)m * DIMENSION;
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      gm[i] = g[i];
+    for(unsigned int k = 0; k < m; ++k)
+      Q[k*B + m] = Q[m*B + k] = dot(DIMENSION, G.data() + (size_t)k * DIMENSION, gm);
+    Q[m*B + m] = dot(DIMENSION, gm, gm);
+    e[m] = err;
+    theta.push_back(0.);
+    m++;
+  };
+
+  for(unsigned int i = 0; i < DIMENSION; ++i)
+    grad[i] *= sign;
+  add_cut(grad.data(), 0.);
+  theta[0] = 1.;
+  double gnorm2 = Q[0];
+  if(gnorm2 < 1.e-20)
+  {
+    printf("subgradient is 0 at x0\n");
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      res[i] = xh[i];
+    return sign * fh;
+  }
+  // first step |g|^2 / u predicts init_gap * max(1, |f|)
+  double u = gnorm2 / (opt->init_gap * std::max(1., fabs(fh)));
+  const double u_min = u * 1.e-6;
+
+  unsigned int iter = 0, nr_serious = 0;
+  while(iter < opt->itermax)
+  {
+    iter++;
+    std::vector<double> em(e.begin(), e.begin() + m);
+    std::vector<double> Qm((size_t)m * m);
+    for(unsigned int i = 0; i < m; ++i)
+      for(unsigned int j = 0; j < m; ++j)
+        Qm[i*m + j] = Q[i*B + j];
+    solve_master(m, Qm, m, em, u, theta);
+
+    // d = G' theta / u, predicted increase delta = theta' e + |G' theta|^2 / u
+    std::fill(d.begin(), d.end(), 0.);
+    for(unsigned int k = 0; k < m; ++k)
+      if(theta[k] > 0.)
+      {
+        const double* gk = G.data() + (size_t)k * DIMENSION;
+        for(unsigned int i = 0; i < DIMENSION; ++i)
+          d[i] += theta[k] * gk[i];
+      }
+    double te = 0.;
+    for(unsigned int k = 0; k < m; ++k)
+      te += theta[k] * e[k];
+    double delta = te + dot(DIMENSION, d.data(), d.data()) / u;
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+    {
+      d[i] /= u;
+      x[i] = xh[i] + d[i];
+    }
+    if(delta <= opt->tol * std::max(1., fabs(fh)))
+    {
+      printf("predicted increase %e is 0, break\n", delta);
+      break;
+    }
+
+    if(!cb_grad_and_func(x.data(), f_val, grad.data()))
+    {
+      printf("grad failed\n");
+      break;
+    }
+    double f = sign * f_val;
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      grad[i] *= sign;
+
+    if(opt->output && (iter-1) % opt->output_iter == 0)
+      printf("iter = %d, u = %.6e, func = %.14e, center = %.14e, delta = %.6e, bundle = %u\n", iter, u, sign * f, sign * fh, delta, m);
+
+    // full bundle : the aggregate cut and the cuts with the largest weights stay
+    if(m == B)
+    {
+      std::vector<unsigned int> order(m);
+      for(unsigned int k = 0; k < m; ++k)
+        order[k] = k;
+      std::sort(order.begin(), order.end(), [&theta](unsigned int a, unsigned int b) { return theta[a] > theta[b]; });
+      order.resize(B - 2);
+      std::sort(order.begin(), order.end());
+      // aggregate cut : subgradient u * d, error theta' e, its products with the kept cuts from Q
+      std::vector<double> qa(B - 2);
+      double qaa = 0.;
+      for(unsigned int t = 0; t < B - 2; ++t)
+      {
+        qa[t] = 0.;
+        for(unsigned int k = 0; k < m; ++k)
+          qa[t] += theta[k] * Q[k*B + order[t]];
+      }
+      for(unsigned int k = 0; k < m; ++k)
+        for(unsigned int l = 0; l < m; ++l)
+          qaa += theta[k] * theta[l] * Q[k*B + l];
+      std::vector<double> Qn((size_t)B * B), Gn((size_t)B * DIMENSION), en(B), thn;
+      for(unsigned int i = 0; i < DIMENSION; ++i)
+        Gn[i] = u * d[i];
+      en[0] = te;
+      Qn[0] = qaa;
+      thn.push_back(0.);
+      for(unsigned int t = 0; t < B - 2; ++t)
+      {
+        std::copy(G.begin() + (size_t)order[t] * DIMENSION, G.begin() + (size_t)(order[t] + 1) * DIMENSION, Gn.begin() + (size_t)(t + 1) * DIMENSION);
+        en[t + 1] = e[order[t]];
+        Qn[t + 1] = Qn[(t + 1)*B] = qa[t];
+        for(unsigned int s = 0; s < B - 2; ++s)
+          Qn[(t + 1)*B + s + 1] = Q[order[t]*B + order[s]];
+        thn.push_back(theta[order[t]]);
+      }
+      G.swap(Gn); Q.swap(Qn); e.swap(en); theta.swap(thn);
+      m = B - 1;
+      double sum = 0.;
+      for(double v : theta)
+        sum += v;
+      theta[0] = (sum < 1.) ? 1. - sum : 0.;
+    }
+
+    if(f - fh >= opt->m_serious * delta)
+    {
+      // serious step : errors move to the new center
+      for(unsigned int k = 0; k < m; ++k)
+        e[k] = std::max(0., e[k] + dot(DIMENSION, G.data() + (size_t)k * DIMENSION, d.data()) + fh - f);
+      double ratio = (f - fh) / delta;
+      xh.swap(x);
+      fh = f;
+      add_cut(grad.data(), 0.);
+      nr_serious++;
+      // the model was accurate, allow longer steps
+      if(ratio > 0.5)
+        u = std::max(u_min, u / 2.);
+    }
+    else
+    {
+      // null step : the cut enriches the model at the center, the prox weight stays
+      // (raising it on null steps shrinks the steps until the predicted increase stalls)
+      add_cut(grad.data(), std::max(0., f - fh - dot(DIMENSION, grad.data(), d.data())));
+    }
+  }
+  if(iter >= opt->itermax)
+    printf("max_iter reached\n");
+
+  for(unsigned int i = 0; i < DIMENSION; ++i)
+    res[i] = xh[i];
+
+  time_t t_done = time(NULL);
+  printf("bundle done, iterations : %d, serious steps : %d\n", iter, nr_serious);
+  printf("f_optimal = %e\n", sign * fh);
+  printf("Time stats : total %.1lf\n", difftime(t_done, t_started));
+  return sign * fh;
+}
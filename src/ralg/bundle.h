@@ -0,0 +1,43 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <functional> // C++11 std::function
+#include "ralg.h"
+
+// proximal bundle method with a bounded bundle, O(dim * bundle_max) memory
+// same callback contract as ralg
+struct bundle_options
+{
+    unsigned int itermax; // 3000, function evaluations
+    unsigned int bundle_max; // 50, cuts kept, the aggregate cut replaces the rest when full
+    double init_gap; // 0.05, first step predicts an increase of init_gap * max(1, |f(x0)|), sets the initial prox weight
+    double m_serious; // 0.1, fraction of the predicted increase for a serious step
+    double tol; // 1.e-7, relative predicted increase to stop
+    bool output;
+    unsigned int output_iter;
+};
+
+const bundle_options defaultBundleOptions = {
+  // itermax
+  3000,
+  // bundle_max
+  50,
+  // init_gap
+  0.05,
+  // m_serious
+  0.1,
+  // tol
+  1.e-7,
+  // output
+  true,
+  // output_iter
+  50
+};
+
+double bundle(const bundle_options* opt,
+          std::function<bool (const double*, double&, double*)> cb_grad_and_func,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res, bool min=RALG_MIN);
+
+#endif // BUNDLE_H
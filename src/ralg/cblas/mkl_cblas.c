@@ -2,83 +2,330 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-void cblas_dcopy(const int __N, const double *__X, const int __incX, double *__Y, const int __incY)
+// Substitutes for the MKL routines used by ralg, with correct strides and non-square matrices.
+// Unit-stride kernels are vectorized with omp simd and cloned for AVX-512 / AVX2 with runtime
+// dispatch (GCC target_clones), matrix routines are split between threads with OpenMP.
+// Build with -fopenmp (see "make no-mkl"), without it everything runs on one thread.
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && (__GNUC__ >= 8)
+#define SIMD_CLONES __attribute__((target_clones("arch=skylake-avx512", "arch=haswell", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+// below these sizes threads cost more than they save
+#define PAR_MIN_LEVEL1 (1 << 16)
+#define PAR_MIN_LEVEL2 (1 << 15)
+// columns of y kept hot while streaming rows of A in the transposed product
+#define COL_BLOCK 1024
+
+// first element touched for a (possibly negative) increment
+#define START(n, inc) (((inc) < 0) ? (1 - (n)) * (inc) : 0)
+
+// ------------------------------------------------------------------------ unit stride kernels
+
+SIMD_CLONES
+static double k_dot(const int n, const double* x, const double* y)
 {
-  int xi = 0, yi = 0;
-  for(; xi < __N && yi < __N; xi+=__incX, yi+=__incY)
-    __Y[yi] = __X[xi];
+  double s = 0.;
+  int i;
+#pragma omp simd reduction(+:s)
+  for(i = 0; i < n; ++i)
+    s += x[i] * y[i];
+  return s;
 }
 
-void cblas_dgemv(const enum CBLAS_ORDER __Order, const enum CBLAS_TRANSPOSE __TransA, const int __M, const int __N, const double __alpha, const double *__A, const int __lda, const double *__X, const int __incX, const double __beta, double *__Y, const int __incY)
+SIMD_CLONES
+static void k_axpy(const int n, const double a, const double* x, double* y)
 {
-  if(__Order != CblasRowMajor)
+  int i;
+#pragma omp simd
+  for(i = 0; i < n; ++i)
+    y[i] += a * x[i];
+}
+
+SIMD_CLONES
+static void k_scal(const int n, const double a, double* x)
+{
+  int i;
+#pragma omp simd
+  for(i = 0; i < n; ++i)
+    x[i] *= a;
+}
+
+// ------------------------------------------------------------------------ level 1
+
+void cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY)
+{
+  if(N <= 0)
+    return;
+  if(incX == 1 && incY == 1)
   {
-    fprintf(stderr, "cblas_dgemv : Order must be CblasRowMajor\n");
+    memcpy(Y, X, sizeof(double) * (size_t)N);
     return;
   }
+  int i, xi = START(N, incX), yi = START(N, incY);
+  for(i = 0; i < N; ++i, xi += incX, yi += incY)
+    Y[yi] = X[xi];
+}
 
-  // y = alpha*A*x + beta*y
-  int yi = 0;
-  for(; yi < __N; yi += __incY)
-    __Y[yi] = __beta * __Y[yi];
-
-  //FIXME simulate actual performance of cblas
-  int i, j;
-  for(i = 0; i < __M; ++i)
-    for(j = 0; j < __N; ++j)
+double cblas_ddot(const int N, const double *X, const int incX, const double *Y, const int incY)
+{
+  if(N <= 0)
+    return 0.;
+  double ret = 0.;
+  if(incX == 1 && incY == 1)
+  {
+    if(N < PAR_MIN_LEVEL1)
+      return k_dot(N, X, Y);
+#pragma omp parallel reduction(+:ret)
     {
-      double v = (__TransA == CblasNoTrans) ? __A[i*__M + j] : __A[j*__N + i];
-      __Y[i] += __alpha * v * __X[j];
+#ifdef _OPENMP
+      int t = omp_get_thread_num(), nt = omp_get_num_threads();
+#else
+      int t = 0, nt = 1;
+#endif
+      int lo = (int)((long)N * t / nt), hi = (int)((long)N * (t + 1) / nt);
+      ret += k_dot(hi - lo, X + lo, Y + lo);
     }
+    return ret;
+  }
+  int i, xi = START(N, incX), yi = START(N, incY);
+  for(i = 0; i < N; ++i, xi += incX, yi += incY)
+    ret += X[xi] * Y[yi];
+  return ret;
 }
 
-double cblas_dnrm2(const int __N, const double *__X, const int __incX)
+double cblas_dnrm2(const int N, const double *X, const int incX)
 {
+  if(N <= 0 || incX <= 0)
+    return 0.;
+  if(incX == 1)
+    return sqrt(cblas_ddot(N, X, 1, X, 1));
   double ret = 0.;
-  int xi = 0;
-  for(; xi < __N; xi += __incX)
-    ret += __X[xi] * __X[xi];
+  int i, xi = 0;
+  for(i = 0; i < N; ++i, xi += incX)
+    ret += X[xi] * X[xi];
   return sqrt(ret);
 }
 
-void cblas_daxpy(const int __N, const double __alpha, const double *__X, const int __incX, double *__Y, const int __incY)
+void cblas_daxpy(const int N, const double alpha, const double *X, const int incX, double *Y, const int incY)
 {
   // compute y <- alpha * x + y
-  int xi;
-  //FIXME what does __incY do?
-  for(xi = 0; xi < __N; xi+= __incX)
-    __Y[xi] += __alpha * __X[xi];
+  if(N <= 0 || alpha == 0.)
+    return;
+  if(incX == 1 && incY == 1)
+  {
+    if(N < PAR_MIN_LEVEL1)
+    {
+      k_axpy(N, alpha, X, Y);
+      return;
+    }
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+      int t = omp_get_thread_num(), nt = omp_get_num_threads();
+#else
+      int t = 0, nt = 1;
+#endif
+      int lo = (int)((long)N * t / nt), hi = (int)((long)N * (t + 1) / nt);
+      k_axpy(hi - lo, alpha, X + lo, Y + lo);
+    }
+    return;
+  }
+  int i, xi = START(N, incX), yi = START(N, incY);
+  for(i = 0; i < N; ++i, xi += incX, yi += incY)
+    Y[yi] += alpha * X[xi];
 }
 
-double cblas_ddot(const int __N, const double *__X, const int __incX, const double* __Y, const int __incY)
+void cblas_dscal(const int N, const double alpha, double *X, const int incX)
 {
-  double ret = 0.;
-  //FIXME again, why need incY?
-  int xi;
-  for(xi = 0; xi < __N; xi += __incX)
-    ret += __X[xi] * __Y[xi];
-  return ret;
+  if(N <= 0 || incX <= 0)
+    return;
+  if(incX == 1)
+  {
+    if(N < PAR_MIN_LEVEL1)
+    {
+      k_scal(N, alpha, X);
+      return;
+    }
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+      int t = omp_get_thread_num(), nt = omp_get_num_threads();
+#else
+      int t = 0, nt = 1;
+#endif
+      int lo = (int)((long)N * t / nt), hi = (int)((long)N * (t + 1) / nt);
+      k_scal(hi - lo, alpha, X + lo);
+    }
+    return;
+  }
+  int i, xi = 0;
+  for(i = 0; i < N; ++i, xi += incX)
+    X[xi] *= alpha;
 }
 
-void cblas_dscal(const int __N, const double __alpha, double *__X, const int __incX)
+// ------------------------------------------------------------------------ level 2
+
+// y = alpha * A * x + beta * y for row-major M x N matrix A, unit strides
+static void gemv_rows(const int M, const int N, const double alpha, const double *A, const int lda,
+                      const double *X, const double beta, double *Y)
 {
-  int xi;
-  for(xi = 0; xi < __N; xi += __incX)
-    __X[xi] *= __alpha;
+  int i;
+#pragma omp parallel for schedule(static) if((long)M * N >= PAR_MIN_LEVEL2)
+  for(i = 0; i < M; ++i)
+  {
+    double v = alpha * k_dot(N, A + (size_t)i * lda, X);
+    Y[i] = (beta == 0.) ? v : v + beta * Y[i];
+  }
 }
 
-void cblas_dger(const enum CBLAS_ORDER __Order, const int __M, const int __N, const double __alpha, const double *__X, const int __incX, const double *__Y, const int __incY, double *__A, const int __lda)
+// y = alpha * A^T * x + beta * y for row-major M x N matrix A, unit strides
+// rows of A are streamed once while a block of y stays in cache, threads own disjoint column blocks
+static void gemv_cols(const int M, const int N, const double alpha, const double *A, const int lda,
+                      const double *X, const double beta, double *Y)
 {
-  //FIXME simulate exactly as cblas does this
-  if(__Order != CblasRowMajor)
+  int nb = (N + COL_BLOCK - 1) / COL_BLOCK, b;
+#pragma omp parallel for schedule(static) if((long)M * N >= PAR_MIN_LEVEL2)
+  for(b = 0; b < nb; ++b)
   {
-    fprintf(stderr, "cblas_dger : Order must be CblasRowMajor\n");
+    int lo = b * COL_BLOCK;
+    int len = (N - lo < COL_BLOCK) ? N - lo : COL_BLOCK;
+    double* y = Y + lo;
+    if(beta == 0.)
+      memset(y, 0, sizeof(double) * (size_t)len);
+    else if(beta != 1.)
+      k_scal(len, beta, y);
+    int i;
+    for(i = 0; i < M; ++i)
+      if(X[i] != 0.)
+        k_axpy(len, alpha * X[i], A + (size_t)i * lda + lo, y);
+  }
+}
+
+void cblas_dgemv(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA, const int M, const int N, const double alpha, const double *A, const int lda, const double *X, const int incX, const double beta, double *Y, const int incY)
+{
+  // y = alpha*op(A)*x + beta*y, A is M x N
+  if(M <= 0 || N <= 0)
+    return;
+  // a column-major matrix is the row-major transpose
+  int by_rows = ((Order == CblasRowMajor) == (TransA == CblasNoTrans));
+  int rows = (Order == CblasRowMajor) ? M : N; // dimensions of the row-major view
+  int cols = (Order == CblasRowMajor) ? N : M;
+  int lenX = by_rows ? cols : rows;
+  int lenY = by_rows ? rows : cols;
+
+  if(incX == 1 && incY == 1)
+  {
+    if(by_rows)
+      gemv_rows(rows, cols, alpha, A, lda, X, beta, Y);
+    else
+      gemv_cols(rows, cols, alpha, A, lda, X, beta, Y);
+    return;
+  }
+
+  // strided vectors go through unit-stride copies
+  double x_buf[256], y_buf[256];
+  double* x = (lenX <= 256) ? x_buf : (double*) malloc(sizeof(double) * (size_t)lenX);
+  double* y = (lenY <= 256) ? y_buf : (double*) malloc(sizeof(double) * (size_t)lenY);
+  if(!x || !y)
+  {
+    fprintf(stderr, "cblas_dgemv : allocation failed\n");
     return;
   }
+  cblas_dcopy(lenX, X, incX, x, 1);
+  cblas_dcopy(lenY, Y, incY, y, 1);
+  if(by_rows)
+    gemv_rows(rows, cols, alpha, A, lda, x, beta, y);
+  else
+    gemv_cols(rows, cols, alpha, A, lda, x, beta, y);
+  cblas_dcopy(lenY, y, 1, Y, incY);
+  if(x != x_buf) free(x);
+  if(y != y_buf) free(y);
+}
+
+void cblas_dger(const enum CBLAS_ORDER Order, const int M, const int N, const double alpha, const double *X, const int incX, const double *Y, const int incY, double *A, const int lda)
+{
+  // A = alpha * x * y^T + A, A is M x N
+  if(M <= 0 || N <= 0 || alpha == 0.)
+    return;
+  // column-major A += x y^T is row-major A^T += y x^T
+  const double* u = (Order == CblasRowMajor) ? X : Y; // scales the rows of the row-major view
+  const double* v = (Order == CblasRowMajor) ? Y : X; // spans the rows
+  int incU = (Order == CblasRowMajor) ? incX : incY;
+  int incV = (Order == CblasRowMajor) ? incY : incX;
+  int rows = (Order == CblasRowMajor) ? M : N;
+  int cols = (Order == CblasRowMajor) ? N : M;
 
-  int i, j;
-  for(i = 0; i < __M; ++i)
-    for(j = 0; j < __N; ++j)
-      __A[__M*i + j] += __alpha * __X[i] * __Y[j];
+  double v_buf[256];
+  double* vv = (double*) v;
+  if(incV != 1)
+  {
+    vv = (cols <= 256) ? v_buf : (double*) malloc(sizeof(double) * (size_t)cols);
+    if(!vv)
+    {
+      fprintf(stderr, "cblas_dger : allocation failed\n");
+      return;
+    }
+    cblas_dcopy(cols, v, incV, vv, 1);
+  }
+  int u0 = START(rows, incU);
+  int i;
+#pragma omp parallel for schedule(static) if((long)rows * cols >= PAR_MIN_LEVEL2)
+  for(i = 0; i < rows; ++i)
+  {
+    double a = alpha * u[u0 + i * incU];
+    if(a != 0.)
+      k_axpy(cols, a, vv, A + (size_t)i * lda);
+  }
+  if(vv != v && vv != v_buf)
+    free(vv);
+}
+
+// ------------------------------------------------------------------------ level 3
+
+void cblas_dgemm(const enum CBLAS_ORDER Order, const enum CBLAS_TRANSPOSE TransA, const enum CBLAS_TRANSPOSE TransB, const int M, const int N, const int K, const double alpha, const double *A, const int lda, const double *B, const int ldb, const double beta, double *C, const int ldc)
+{
+  // C = alpha*op(A)*op(B) + beta*C, C is M x N, K is the inner dimension
+  if(M <= 0 || N <= 0)
+    return;
+  // column-major C is the row-major C^T = op(B)^T * op(A)^T
+  if(Order == CblasColMajor)
+  {
+    cblas_dgemm(CblasRowMajor, TransB, TransA, N, M, K, alpha, B, ldb, A, lda, beta, C, ldc);
+    return;
+  }
+  // every row of C is written once while the rows of op(B) are reused from cache,
+  // this is the shape of the low-rank update B += U^T V in ralg (K small)
+  int i;
+#pragma omp parallel for schedule(static) if((long)M * N >= PAR_MIN_LEVEL2)
+  for(i = 0; i < M; ++i)
+  {
+    double* c = C + (size_t)i * ldc;
+    if(beta == 0.)
+      memset(c, 0, sizeof(double) * (size_t)N);
+    else if(beta != 1.)
+      k_scal(N, beta, c);
+    if(alpha == 0.)
+      continue;
+    int p, j;
+    for(p = 0; p < K; ++p)
+    {
+      double a = alpha * ((TransA == CblasNoTrans) ? A[(size_t)i * lda + p] : A[(size_t)p * lda + i]);
+      if(a == 0.)
+        continue;
+      if(TransB == CblasNoTrans)
+        k_axpy(N, a, B + (size_t)p * ldb, c);
+      else
+        for(j = 0; j < N; ++j)
+          c[j] += a * B[(size_t)j * ldb + p];
+    }
+  }
 }
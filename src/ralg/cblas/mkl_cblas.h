@@ -1,5 +1,6 @@
 // This file define routines used in ralg implementation.
 // Impementations can be used when efficient MKL is not available.
+// Row- and column-major orders and arbitrary (also negative) increments are supported.
 #ifndef _MKL_CBLAS_
 #define _MKL_CBLAS_
 
@@ -17,6 +18,7 @@ void cblas_daxpy(const int, const double, const double*, const int, double*, con
 double cblas_ddot(const int, const double*, const int, const double*, const int);
 void cblas_dscal(const int, const double, double*, const int);
 void cblas_dger(const enum CBLAS_ORDER, const int, const int, const double, const double*, const int, const double*, const int, double*, const int);
+void cblas_dgemm(const enum CBLAS_ORDER, const enum CBLAS_TRANSPOSE, const enum CBLAS_TRANSPOSE, const int, const int, const int, const double, const double*, const int, const double*, const int, const double, double*, const int);
 
 #ifdef __cplusplus
 }
@@ -4,6 +4,12 @@
 #include <malloc.h>
 #include <cstdio>
 #include <ctime>
+#include <cmath>
+#include <cstring>
+#include <utility> // std::swap
+#include <string>
+#include <vector>
+#include <unistd.h> // fsync
 
 #ifndef min
 #define min(a,b) (((a)<(b))?(a):(b))
@@ -35,18 +41,352 @@ void dfree(double** m)
   free(m);
 }
 
+// with float storage dilations are always applied in blocks of at least this many
+const unsigned int FloatMinRank = 8;
+
+// space dilation matrix B = B0 + sum_k c_k u_k v_k^T
+// with lazy_rank > 0 the rank-one dilations are kept aside and applied to B0 as one block update
+// once lazy_rank of them are pending, so products stream B0 once plus O(dim * rank)
+// with float storage B0 = scale * Bf, products accumulate in double and the update of Bf is
+// always a block update (rounded once per entry), scale is renormalized after it
+class dilation
+{
+public:
+  dilation(unsigned int dim, unsigned int rank, double diag, bool use_float)
+    : dim(dim), rank(rank), nr_pending(0), scale(1.), B(nullptr), Bf(nullptr), row(nullptr), rounded(false)
+  {
+    if(use_float)
+    {
+      this->rank = max(rank, FloatMinRank);
+      Bf = (float*) calloc((size_t)dim * dim, sizeof(float));
+      row = (double*) malloc(sizeof(double)*dim);
+      if(Bf == NULL || row == NULL)
+        printf("allocation failed (%u, float)\n", dim);
+    }
+    else
+      B = dalloc(dim);
+    U = V = coef = nullptr;
+    if(this->rank > 0)
+    {
+      U = (double*) malloc(sizeof(double)*dim*this->rank);
+      V = (double*) malloc(sizeof(double)*dim*this->rank);
+      coef = (double*) malloc(sizeof(double)*this->rank);
+      if(U == NULL || V == NULL || coef == NULL)
+        printf("allocation failed (lazy rank %u)\n", this->rank);
+    }
+    // null after init
+    set_identity(diag);
+  }
+
+  ~dilation()
+  {
+    free(coef);
+    free(V);
+    free(U);
+    free(row);
+    free(Bf);
+    if(B)
+      dfree(B);
+  }
+
+  // y = alpha * B^T x
+  void tmul(double alpha, const double* x, double* y)
+  {
+    if(Bf)
+    {
+      const double a = alpha * scale;
+      for(unsigned int j = 0; j < dim; ++j)
+        y[j] = 0.;
+      for(unsigned int i = 0; i < dim; ++i)
+      {
+        const double xi = a * x[i];
+        if(xi == 0.)
+          continue;
+        const float* bi = Bf + (size_t)i*dim;
+        for(unsigned int j = 0; j < dim; ++j)
+          y[j] += xi * bi[j];
+      }
+    }
+    else
+      cblas_dgemv(CblasRowMajor, CblasTrans, dim, dim, alpha, B[0], dim, x, 1, 0., y, 1);
+    if(nr_pending > 0)
+    {
+      cblas_dgemv(CblasRowMajor, CblasNoTrans, nr_pending, dim, 1., U, dim, x, 1, 0., coef, 1);
+      cblas_dgemv(CblasRowMajor, CblasTrans, nr_pending, dim, alpha, V, dim, coef, 1, 1., y, 1);
+    }
+  }
+
+  // y = alpha * B x
+  void mul(double alpha, const double* x, double* y)
+  {
+    if(Bf)
+    {
+      const double a = alpha * scale;
+      for(unsigned int i = 0; i < dim; ++i)
+      {
+        const float* bi = Bf + (size_t)i*dim;
+        // independent partial sums, so the compiler can vectorize without reassociating
+        double s[8] = {0., 0., 0., 0., 0., 0., 0., 0.};
+        unsigned int j = 0;
+        for(; j + 8 <= dim; j += 8)
+          for(unsigned int t = 0; t < 8; ++t)
+            s[t] += bi[j+t] * x[j+t];
+        for(; j < dim; ++j)
+          s[0] += bi[j] * x[j];
+        y[i] = a * (((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7])));
+      }
+    }
+    else
+      cblas_dgemv(CblasRowMajor, CblasNoTrans, dim, dim, alpha, B[0], dim, x, 1, 0., y, 1);
+    if(nr_pending > 0)
+    {
+      cblas_dgemv(CblasRowMajor, CblasNoTrans, nr_pending, dim, 1., V, dim, x, 1, 0., coef, 1);
+      cblas_dgemv(CblasRowMajor, CblasTrans, nr_pending, dim, alpha, U, dim, coef, 1, 1., y, 1);
+    }
+  }
+
+  // B += c * u v^T
+  void update(double c, const double* u, const double* v)
+  {
+    if(rank == 0)
+    {
+      cblas_dger(CblasRowMajor, dim, dim, c, u, 1, v, 1, B[0], dim);
+      return;
+    }
+    cblas_dcopy(dim, u, 1, U + (size_t)nr_pending*dim, 1);
+    cblas_dscal(dim, c, U + (size_t)nr_pending*dim, 1);
+    cblas_dcopy(dim, v, 1, V + (size_t)nr_pending*dim, 1);
+    if(++nr_pending == rank)
+      flush();
+  }
+
+  // B = diag * I
+  void reset(double diag)
+  {
+    nr_pending = 0;
+    if(Bf)
+      memset(Bf, 0, sizeof(float)*dim*dim);
+    else
+      cblas_dscal(dim*dim, 0, B[0], 1);
+    set_identity(diag);
+  }
+
+  // true once after pending updates were rounded into single precision B
+  bool take_rounded()
+  {
+    bool r = rounded;
+    rounded = false;
+    return r;
+  }
+
+  bool is_float() const { return Bf != nullptr; }
+
+  // checkpoint in the own precision, pending updates are applied first
+  bool save(FILE* f)
+  {
+    if(nr_pending > 0)
+      flush();
+    unsigned int fl = is_float() ? 1 : 0;
+    if(fwrite(&fl, sizeof fl, 1, f) != 1 || fwrite(&scale, sizeof scale, 1, f) != 1)
+      return false;
+    if(Bf)
+      return fwrite(Bf, sizeof(float), (size_t)dim*dim, f) == (size_t)dim*dim;
+    return fwrite(B[0], sizeof(double), (size_t)dim*dim, f) == (size_t)dim*dim;
+  }
+
+  // the stored precision may differ from the current one
+  bool load(FILE* f)
+  {
+    unsigned int fl;
+    double s;
+    if(fread(&fl, sizeof fl, 1, f) != 1 || fread(&s, sizeof s, 1, f) != 1)
+      return false;
+    nr_pending = 0;
+    if(fl == 1 && Bf)
+    {
+      scale = s;
+      return fread(Bf, sizeof(float), (size_t)dim*dim, f) == (size_t)dim*dim;
+    }
+    if(fl == 0 && !Bf)
+      return fread(B[0], sizeof(double), (size_t)dim*dim, f) == (size_t)dim*dim;
+    // convert row by row
+    std::vector<float> rf(fl == 1 ? dim : 0);
+    std::vector<double> rd(fl == 0 ? dim : 0);
+    scale = 1.;
+    for(unsigned int i = 0; i < dim; ++i)
+    {
+      if(fl == 1 && fread(rf.data(), sizeof(float), dim, f) != dim)
+        return false;
+      if(fl == 0 && fread(rd.data(), sizeof(double), dim, f) != dim)
+        return false;
+      for(unsigned int j = 0; j < dim; ++j)
+      {
+        if(Bf)
+          Bf[(size_t)i*dim + j] = (float) rd[j];
+        else
+          B[i][j] = s * rf[j];
+      }
+    }
+    return true;
+  }
+
+private:
+  void set_identity(double diag)
+  {
+    if(Bf)
+    {
+      scale = diag;
+      for(size_t i = 0; i < dim; ++i)
+        Bf[i*dim + i] = 1.f;
+    }
+    else
+      for(unsigned int i = 0; i < dim; ++i)
+        B[i][i] = diag;
+  }
+
+  // B0 += U^T V
+  void flush()
+  {
+    if(Bf)
+      flush_float();
+    else
+      cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, dim, dim, nr_pending, 1., U, dim, V, dim, 1., B[0], dim);
+    nr_pending = 0;
+  }
+
+  // Bf += U^T V / scale row by row in double, then keep max |Bf| near 1 so the entries stay in float range
+  void flush_float()
+  {
+    const double inv = 1. / scale;
+    float big = 0.f;
+    for(unsigned int i = 0; i < dim; ++i)
+    {
+      float* bi = Bf + (size_t)i*dim;
+      for(unsigned int j = 0; j < dim; ++j)
+        row[j] = bi[j];
+      for(unsigned int p = 0; p < nr_pending; ++p)
+        cblas_daxpy(dim, U[(size_t)p*dim + i] * inv, V + (size_t)p*dim, 1, row, 1);
+      for(unsigned int j = 0; j < dim; ++j)
+      {
+        bi[j] = (float) row[j];
+        big = max(big, fabsf(bi[j]));
+      }
+    }
+    rounded = true;
+    if(big > 0.f && (big < 1.f/256 || big > 256.f))
+    {
+      const float r = 1.f / big;
+      for(size_t i = 0; i < (size_t)dim*dim; ++i)
+        Bf[i] *= r;
+      scale *= big;
+    }
+  }
+
+  unsigned int dim, rank, nr_pending;
+  double scale; // float storage only
+  double** B;
+  float* Bf;
+  double* row;
+  double* U; // pending c_k u_k, row-wise
+  double* V; // pending v_k, row-wise
+  double* coef;
+  bool rounded;
+};
+
+// ------------------------------------------------------------------------ checkpoints
+
+const char RalgCheckpointMagic[8] = "RALGCKP";
+const unsigned int RalgCheckpointVersion = 2;
+
+struct ralg_checkpoint
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int dim;
+  unsigned int iter;
+  unsigned int nr_matrix_reset;
+  double step;
+  double f_optimal;
+  double f_start; // function value at x0, tells checkpoints of another problem apart
+  uint64_t id; // ralg_options::checkpoint_id
+};
+
+// written to [fname].tmp, synced and renamed, so [fname] is always a complete checkpoint
+static bool save_checkpoint(const ralg_options* opt, const ralg_checkpoint& h, const double* xk, const double* res, dilation& B)
+{
+  std::string tmpname = std::string(opt->checkpoint) + ".tmp";
+  FILE* f = fopen(tmpname.c_str(), "wb");
+  if(!f)
+  {
+    printf("Cannot open %s for ralg checkpoint\n", tmpname.c_str());
+    return false;
+  }
+  bool ok = fwrite(&h, sizeof h, 1, f) == 1
+         && fwrite(xk, sizeof(double), h.dim, f) == h.dim
+         && fwrite(res, sizeof(double), h.dim, f) == h.dim
+         && B.save(f)
+         && (!opt->checkpoint_extra || opt->checkpoint_extra(f, true));
+  ok = (fflush(f) == 0) && (fsync(fileno(f)) == 0) && ok;
+  ok = (fclose(f) == 0) && ok;
+  if(ok && rename(tmpname.c_str(), opt->checkpoint) != 0)
+    ok = false;
+  if(!ok)
+  {
+    printf("Failed to write ralg checkpoint %s\n", opt->checkpoint);
+    remove(tmpname.c_str());
+  }
+  return ok;
+}
+
+// on success xk, res, B and the header are replaced, on failure B is back at the initial matrix
+static bool load_checkpoint(const ralg_options* opt, ralg_checkpoint& h, unsigned int dim, double f_start, double* xk, double* res, dilation& B)
+{
+  FILE* f = fopen(opt->checkpoint, "rb");
+  if(!f)
+  {
+    printf("No ralg checkpoint %s, starting from x0\n", opt->checkpoint);
+    return false;
+  }
+  bool ok = true;
+  if(fread(&h, sizeof h, 1, f) != 1 || memcmp(h.magic, RalgCheckpointMagic, sizeof h.magic) != 0 || h.version != RalgCheckpointVersion)
+  {
+    printf("%s is not a ralg checkpoint, starting from x0\n", opt->checkpoint);
+    ok = false;
+  }
+  else if(h.dim != dim || h.id != opt->checkpoint_id || fabs(h.f_start - f_start) > 1.e-9 * max(1., fabs(f_start)))
+  {
+    printf("Checkpoint %s is for another problem (dim %u, id %016llx, f(x0) = %.14e), starting from x0\n", opt->checkpoint, h.dim,
+      static_cast<unsigned long long>(h.id), h.f_start);
+    ok = false;
+  }
+  else if(fread(xk, sizeof(double), dim, f) != dim || fread(res, sizeof(double), dim, f) != dim || !B.load(f)
+       || (opt->checkpoint_extra && !opt->checkpoint_extra(f, false)))
+  {
+    printf("Checkpoint %s is truncated, starting from x0\n", opt->checkpoint);
+    B.reset(opt->b_init*1.);
+    ok = false;
+  }
+  fclose(f);
+  return ok;
+}
+
 double ralg(const ralg_options* opt,
           std::function<bool (const double*, double&, double*)> cb_grad_and_func,
           unsigned int DIMENSION,
           double* x0,
           double* res,
-          bool is_min)
+          bool is_min,
+          ralg_batch_cb cb_batch)
 {
   double* xk;
-  double** B;
   double* grad;
   double* tmp; // used for different tasks, store one for memory reduce
   double* tmp2;
+  // lazy mode only: B^T grad and B B^T grad for the current and previous gradient
+  double* bg = nullptr;
+  double* bbg = nullptr;
+  double* bg_old = nullptr;
+  double* bbg_old = nullptr;
 
   unsigned int i,j;
   unsigned int iter = 0;
@@ -54,10 +394,13 @@ double ralg(const ralg_options* opt,
   double d_var;
   double step_diff;
   double f_val;
+  const double sign = (is_min)?(1.):(-1.);
 
   double f_optimal;
 
   unsigned int nr_matrix_reset = 0;
+  unsigned int nr_float_reset = 0;
+  double float_err = 0.; // squared relative error of single precision B since the last reset
   printf("Running ralg_blas v2 with matrix renewal, copyright Eugene Lykhovyd, 2014-2018.\n");
 
   time_t t_started = time(NULL);
@@ -67,15 +410,43 @@ double ralg(const ralg_options* opt,
     printf("opt->b_init wrong value %e\n", opt->b_init);
     return 0.;
   }
-  // null after init
-  B = dalloc(DIMENSION);
-  for(i = 0; i < DIMENSION; ++i)
-    B[i][i] = opt->b_init*1.;
+  const bool lazy = (opt->lazy_rank > 0 || opt->float_b); // float storage uses the lazy iteration too
+  if(opt->lazy_rank > 0)
+    printf("ralg: dilations applied to B in blocks of %u\n", opt->lazy_rank);
+  if(opt->float_b)
+    printf("ralg: B stored in single precision, error tolerance %e\n", opt->float_tol);
+  dilation B(DIMENSION, opt->lazy_rank, opt->b_init*1., opt->float_b);
 
   xk = (double*) malloc(sizeof(double)*DIMENSION);
   grad = (double*) malloc(sizeof(double)*DIMENSION);
   tmp = (double*) malloc(sizeof(double)*DIMENSION);
   tmp2 = (double*) malloc(sizeof(double)*DIMENSION);
+  if(lazy)
+  {
+    bg = (double*) malloc(sizeof(double)*DIMENSION);
+    bbg = (double*) malloc(sizeof(double)*DIMENSION);
+    bg_old = (double*) malloc(sizeof(double)*DIMENSION);
+    bbg_old = (double*) malloc(sizeof(double)*DIMENSION);
+  }
+  bool cached = false; // bg, bbg are valid for the current B and grad
+
+  // speculative line search: the trial points of one batch and the step state after each of them
+  const unsigned int spec = (cb_batch && opt->spec_width > 1) ? opt->spec_width : 1;
+  std::vector<double> spec_x, spec_g, spec_f, spec_step, spec_diff;
+  std::vector<double*> spec_xp, spec_gp;
+  std::vector<unsigned int> spec_i;
+  if(spec > 1)
+  {
+    printf("ralg: line search evaluates %u steps at once\n", spec);
+    spec_x.resize((size_t)spec*DIMENSION);
+    spec_g.resize((size_t)spec*DIMENSION);
+    spec_f.resize(spec); spec_step.resize(spec); spec_diff.resize(spec); spec_i.resize(spec);
+    for(unsigned int t = 0; t < spec; ++t)
+    {
+      spec_xp.push_back(spec_x.data() + (size_t)t*DIMENSION);
+      spec_gp.push_back(spec_g.data() + (size_t)t*DIMENSION);
+    }
+  }
 
   cblas_dcopy(DIMENSION, x0, 1, xk, 1);
   printf("init done\n");
@@ -88,12 +459,59 @@ double ralg(const ralg_options* opt,
 
   f_optimal = f_val;
 
+  ralg_checkpoint ckp;
+  memcpy(ckp.magic, RalgCheckpointMagic, sizeof ckp.magic);
+  ckp.version = RalgCheckpointVersion;
+  ckp.dim = DIMENSION;
+  ckp.f_start = f_val;
+  ckp.id = opt->checkpoint_id;
+  auto checkpoint = [&]()
+  {
+    ckp.iter = iter;
+    ckp.nr_matrix_reset = nr_matrix_reset;
+    ckp.step = step;
+    ckp.f_optimal = f_optimal;
+    save_checkpoint(opt, ckp, xk, res, B);
+  };
+
+  if(opt->checkpoint)
+  {
+    // xk, res go to scratch first, so a failed load leaves them alone
+    if(load_checkpoint(opt, ckp, DIMENSION, f_val, tmp, tmp2, B))
+    {
+      iter = ckp.iter;
+      nr_matrix_reset = ckp.nr_matrix_reset;
+      step = ckp.step;
+      f_optimal = ckp.f_optimal;
+      cblas_dcopy(DIMENSION, tmp, 1, xk, 1);
+      cblas_dcopy(DIMENSION, tmp2, 1, res, 1);
+      printf("Resumed from checkpoint %s at iter %d, step %.14e, f_optimal %.14e\n", opt->checkpoint, iter, step, f_optimal);
+      if(!cb_grad_and_func(xk, f_val, grad))
+      {
+        printf("grad failed, aborting\n");
+        return 0.;
+      }
+    }
+  }
+
   do
   {
     iter++;
 
-    cblas_dgemv(CblasRowMajor, CblasTrans, DIMENSION, DIMENSION, ((is_min)?(1.):(-1.)), B[0], DIMENSION, grad, 1, 0., tmp, 1);
-    d_var = cblas_dnrm2(DIMENSION, tmp, 1);
+    if(lazy)
+    {
+      if(!cached)
+      {
+        B.tmul(1., grad, bg);
+        B.mul(1., bg, bbg);
+      }
+      d_var = cblas_dnrm2(DIMENSION, bg, 1);
+    }
+    else
+    {
+      B.tmul(sign, grad, tmp);
+      d_var = cblas_dnrm2(DIMENSION, tmp, 1);
+    }
 
     if(d_var < opt->b_mult_grad_min)
     {
@@ -101,7 +519,13 @@ double ralg(const ralg_options* opt,
       break;
     }
 
-    cblas_dgemv(CblasRowMajor, CblasNoTrans, DIMENSION, DIMENSION, 1./d_var, B[0], DIMENSION, tmp, 1, 0., tmp2, 1);
+    if(lazy)
+    {
+      cblas_dcopy(DIMENSION, bbg, 1, tmp2, 1);
+      cblas_dscal(DIMENSION, sign/d_var, tmp2, 1);
+    }
+    else
+      B.mul(1./d_var, tmp, tmp2);
     // now tmp2 is the vector we are moving in direction to
     // running adaprive step
     i=0;
@@ -113,6 +537,49 @@ double ralg(const ralg_options* opt,
 
     step_diff = 0.;
 
+    // the trial points of the sequential search below are known in advance, they are evaluated
+    // in batches and the first sign flip is taken, so the trajectory is the same
+    while(spec > 1)
+    {
+      const double* prev = xk;
+      for(unsigned int t = 0; t < spec; ++t)
+      {
+        cblas_dcopy(DIMENSION, prev, 1, spec_xp[t], 1);
+        cblas_daxpy(DIMENSION, -step, tmp2, 1, spec_xp[t], 1);
+        step_diff = step_diff + step;
+        if(++i == opt->nh)
+        {
+          step = step * opt->q2;
+          i = 0;
+        }
+        spec_step[t] = step; spec_diff[t] = step_diff; spec_i[t] = i;
+        prev = spec_xp[t];
+      }
+      unsigned int t = 0;
+      bool ok = cb_batch(spec, spec_xp.data(), spec_f.data(), spec_gp.data());
+      if(!ok)
+        printf("grad failed\n");
+      else
+        while(t + 1 < spec && sign*cblas_ddot(DIMENSION, spec_gp[t], 1, tmp2, 1) > 0. && j + t + 1 <= opt->stepmax)
+          t++;
+      if(ok && opt->spec_accepted)
+        opt->spec_accepted(t);
+      // state after trial t
+      j += t + 1;
+      step = spec_step[t]; step_diff = spec_diff[t]; i = spec_i[t];
+      f_val = spec_f[t];
+      cblas_dcopy(DIMENSION, spec_xp[t], 1, xk, 1);
+      cblas_dcopy(DIMENSION, spec_gp[t], 1, grad, 1);
+      if(!ok || sign*cblas_ddot(DIMENSION, grad, 1, tmp2, 1) <= 0.)
+        break;
+      if(j > opt->stepmax)
+      {
+        printf("function is unbounded, done %d steps, current step %.14e\n", j, step);
+        return 0.;
+      }
+    }
+
+    if(spec == 1)
     do
     {
       // tmp2 - min direction
@@ -133,7 +600,7 @@ double ralg(const ralg_options* opt,
         step = step * opt->q2;
         i = 0;
       }
-      if(((is_min)?(1.):(-1.))*cblas_ddot(DIMENSION, grad, 1, tmp2, 1) <= 0.)
+      if(sign*cblas_ddot(DIMENSION, grad, 1, tmp2, 1) <= 0.)
           break;
       if(j > opt->stepmax)
       {
@@ -163,8 +630,22 @@ double ralg(const ralg_options* opt,
     if(j == 1)
       step = step * opt->q1; //decreasing
 
-    cblas_daxpy(DIMENSION, -1., grad, 1, tmp, 1);
-    cblas_dgemv(CblasRowMajor, CblasTrans, DIMENSION, DIMENSION, ((is_min)?(-1.):(1)), B[0], DIMENSION, tmp, 1, 0., tmp2, 1);
+    if(lazy)
+    {
+      // B^T (g_old - g) = bg_old - B^T g, and B applied to it follows the same way,
+      // so the two products below are all that touches B in this iteration
+      std::swap(bg, bg_old);
+      std::swap(bbg, bbg_old);
+      B.tmul(1., grad, bg);
+      B.mul(1., bg, bbg);
+      cblas_dcopy(DIMENSION, bg_old, 1, tmp2, 1);
+      cblas_daxpy(DIMENSION, -1., bg, 1, tmp2, 1);
+    }
+    else
+    {
+      cblas_daxpy(DIMENSION, -1., grad, 1, tmp, 1);
+      B.tmul(-sign, tmp, tmp2);
+    }
     d_var = cblas_dnrm2(DIMENSION, tmp2, 1);
     if (opt->output && (iter-1) % opt->output_iter == 0)
     {
@@ -172,48 +653,102 @@ double ralg(const ralg_options* opt,
     }
     if(d_var > opt->reset)
     {
-      cblas_dscal(DIMENSION, 1./d_var, tmp2, 1);
-      cblas_dgemv(CblasRowMajor, CblasNoTrans, DIMENSION, DIMENSION, 1., B[0], DIMENSION, tmp2, 1, 0., tmp, 1);
-      cblas_dger(CblasRowMajor, DIMENSION, DIMENSION, (1. / opt->alpha - 1.), tmp, 1, tmp2, 1, B[0], DIMENSION);
+      const double c = 1. / opt->alpha - 1.;
+      if(lazy)
+      {
+        cblas_dscal(DIMENSION, -sign/d_var, tmp2, 1);
+        cblas_dcopy(DIMENSION, bbg_old, 1, tmp, 1);
+        cblas_daxpy(DIMENSION, -1., bbg, 1, tmp, 1);
+        cblas_dscal(DIMENSION, -sign/d_var, tmp, 1);
+        B.update(c, tmp, tmp2);
+        // carry bg, bbg over to the dilated B: B_new^T g = B^T g + c xi (xi^T B^T g), B_new y = B y + c (B xi) (xi^T y)
+        double a = cblas_ddot(DIMENSION, tmp2, 1, bg, 1);
+        cblas_daxpy(DIMENSION, c*a, tmp2, 1, bg, 1);
+        cblas_daxpy(DIMENSION, c*a, tmp, 1, bbg, 1);
+        a = cblas_ddot(DIMENSION, tmp2, 1, bg, 1);
+        cblas_daxpy(DIMENSION, c*a, tmp, 1, bbg, 1);
+        cached = true;
+        // the carried B^T g is exact for the dilated B, the recomputed one shows the rounding of this block,
+        // bg, bbg are resynced so the next check sees only the next rounding, the increments add as a random walk
+        if(B.take_rounded())
+        {
+          B.tmul(1., grad, tmp);
+          cblas_daxpy(DIMENSION, -1., bg, 1, tmp, 1);
+          const double e = cblas_dnrm2(DIMENSION, tmp, 1) / cblas_dnrm2(DIMENSION, bg, 1);
+          cblas_daxpy(DIMENSION, 1., tmp, 1, bg, 1);
+          B.mul(1., bg, bbg);
+          float_err += e * e;
+          if(sqrt(float_err) > opt->float_tol)
+          {
+            printf("Float matrix reset on iter %d, error %e\n", iter, sqrt(float_err));
+            nr_float_reset ++;
+            B.reset(1.);
+            cached = false;
+            float_err = 0.;
+          }
+        }
+      }
+      else
+      {
+        cblas_dscal(DIMENSION, 1./d_var, tmp2, 1);
+        B.mul(1., tmp2, tmp);
+        B.update(c, tmp, tmp2);
+      }
     }
     else
     {
       printf("Matrix reset on iter %d\n", iter);
 
       nr_matrix_reset ++;
-      cblas_dscal(DIMENSION*DIMENSION, 0, B[0], 1);
-      for(i=0;i<DIMENSION;++i)
-        B[i][i] = 1.;
+      B.reset(1.);
+      cached = false;
+      float_err = 0.;
       step = step_diff / opt->nh;
     }
 
+    if(opt->checkpoint && opt->checkpoint_iter > 0 && iter % opt->checkpoint_iter == 0)
+      checkpoint();
+
     if(iter > opt->itermax)
     {
       printf("max_iter reached\n");
       break;
     }
+    if(opt->should_stop && opt->should_stop())
+    {
+      printf("stopped by caller on iter %d\n", iter);
+      break;
+    }
   } while(step > opt->stepmin);
   if(step <= opt->stepmin)
   {
       printf("stepmin reached\n");
   }
 
+  // a finished run is not resumed, only an interrupted one
+  if(opt->checkpoint)
+    remove(opt->checkpoint);
+
   if(opt->is_monotone)
     cblas_dcopy(DIMENSION, xk, 1, res, 1);
 
   time_t t_done = time(NULL);
 
   printf("ralg done, iterations : %d, matrix resets : %d\n", iter, nr_matrix_reset);
+  if(opt->float_b)
+    printf("float matrix resets : %d\n", nr_float_reset);
   printf("f_optimal = %e\n", f_optimal);
   printf("Time stats : init %.1lf, compute %.1lf, total %.1lf\n", difftime(t_inited, t_started), difftime(t_done, t_inited), difftime(t_done, t_started));
 
   //memory release
+  free(bbg_old);
+  free(bg_old);
+  free(bbg);
+  free(bg);
   free(tmp2);
   free(tmp);
   free(grad);
   free(xk);
-  dfree(B);
 
   return f_optimal;
 }
-
@@ -4,6 +4,8 @@
 #include <cfloat>
 #include <functional> // C++11 std::function
 #include <climits>
+#include <cstdio>
+#include <cstdint>
 
 #define RALG_MAX false
 #define RALG_MIN true
@@ -27,6 +29,16 @@ struct ralg_options
     unsigned int output_iter;
     double b_init;
     bool is_monotone;
+    unsigned int lazy_rank; // 0, pending rank-one dilations applied to B as one block update
+    bool float_b; // false, B stored in single precision as scale * Bf
+    double float_tol; // 1.e-4, accumulated relative error of single precision B before it is reset
+    const char* checkpoint; // nullptr, file for the full ralg state, resumed from when it exists, removed when ralg ends
+    uint64_t checkpoint_id; // 0, problem identity stored in the checkpoint, a checkpoint with another id is not resumed
+    unsigned int checkpoint_iter; // 100
+    std::function<bool (FILE*, bool)> checkpoint_extra; // nullptr, caller state appended to the checkpoint (true - save, false - load)
+    unsigned int spec_width; // 1, trial steps of the line search evaluated at once through the batch callback
+    std::function<void (unsigned int)> spec_accepted; // nullptr, called with the point of a batch the line search moves to
+    std::function<bool ()> should_stop; // nullptr, polled once per iteration, true ends the run
 };
 
 const ralg_options defaultOptions = {
@@ -59,14 +71,38 @@ const ralg_options defaultOptions = {
   // b_init
   1.,
   // is_monotone
-  true
+  true,
+  // lazy_rank
+  0,
+  // float_b
+  false,
+  // float_tol
+  1.e-4,
+  // checkpoint
+  nullptr,
+  // checkpoint_id
+  0,
+  // checkpoint_iter
+  100,
+  // checkpoint_extra
+  nullptr,
+  // spec_width
+  1,
+  // spec_accepted
+  nullptr,
+  // should_stop
+  nullptr
 };
 
+// evaluates count points at once (points, function values, gradients), any order or concurrently
+typedef std::function<bool (unsigned int, const double* const*, double*, double* const*)> ralg_batch_cb;
+
 double ralg(const ralg_options* opt,
           std::function<bool (const double*, double&, double*)> cb_grad_and_func,
           unsigned int DIMENSION,
           double* x0,
-          double* res, bool min=RALG_MIN);
+          double* res, bool min=RALG_MIN,
+          ralg_batch_cb cb_batch=nullptr);
 
 #endif // RALG_H
 
@@ -0,0 +1,130 @@
+#include "volume.h"
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+static double dot(unsigned int n, const double* x, const double* y)
+{
+  double s = 0.;
+  for(unsigned int i = 0; i < n; ++i)
+    s += x[i] * y[i];
+  return s;
+}
+
+double volume(const volume_options* opt,
+          std::function<bool (const double*, double&, double*)> cb_grad_and_func,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res,
+          bool is_min)
+{
+  // internally the concave function sign * f is maximized
+  const double sign = (is_min)?(-1.):(1.);
+  std::vector<double> xb(x0, x0 + DIMENSION); // center, the best point so far
+  std::vector<double> v(DIMENSION);            // direction, convex combination of subgradients
+  std::vector<double> x(DIMENSION);
+  std::vector<double> grad(DIMENSION);
+
+  printf("Running volume algorithm\n");
+  time_t t_started = time(NULL);
+
+  double f_val;
+  if(!cb_grad_and_func(xb.data(), f_val, grad.data()))
+  {
+    printf("grad failed, aborting\n");
+    return 0.;
+  }
+  double fb = sign * f_val;
+  for(unsigned int i = 0; i < DIMENSION; ++i)
+    v[i] = sign * grad[i];
+
+  double lambda = opt->lambda;
+  double alpha_max = opt->alpha_max;
+  unsigned int reds = 0;
+  double f_window = fb; // center value at the start of the window
+  unsigned int iter = 0;
+  unsigned int nr_improve = 0;
+
+  while(iter < opt->itermax)
+  {
+    iter++;
+    double vv = dot(DIMENSION, v.data(), v.data());
+    if(vv < 1.e-20)
+    {
+      printf("subgradient is 0, break\n");
+      break;
+    }
+    // Polyak step towards an estimated target
+    double target = fb + opt->target_gap * fmax(1., fabs(fb));
+    double t = lambda * (target - fb) / vv;
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      x[i] = xb[i] + t * v[i];
+
+    if(!cb_grad_and_func(x.data(), f_val, grad.data()))
+    {
+      printf("grad failed\n");
+      break;
+    }
+    double f = sign * f_val;
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      grad[i] *= sign;
+
+    // alpha minimizing |alpha g + (1 - alpha) v| on [alpha_max / 10, alpha_max]
+    double gg = dot(DIMENSION, grad.data(), grad.data());
+    double gv = dot(DIMENSION, grad.data(), v.data());
+    double denom = gg - 2. * gv + vv;
+    double alpha = (denom > 0.) ? (vv - gv) / denom : alpha_max;
+    alpha = fmin(alpha_max, fmax(alpha_max / 10., alpha));
+    for(unsigned int i = 0; i < DIMENSION; ++i)
+      v[i] = alpha * grad[i] + (1. - alpha) * v[i];
+
+    if(f > fb)
+    {
+      // green step (the new subgradient still points along v) grows lambda, yellow keeps it
+      if(dot(DIMENSION, grad.data(), v.data()) > 0.)
+        lambda = fmin(2., lambda * 1.1);
+      xb.swap(x);
+      fb = f;
+      reds = 0;
+      nr_improve++;
+    }
+    else if(++reds >= opt->red_limit)
+    {
+      lambda *= 0.66;
+      reds = 0;
+      if(lambda < opt->lambda_min)
+      {
+        printf("lambda is 0, break\n");
+        break;
+      }
+    }
+
+    if(opt->output && (iter-1) % opt->output_iter == 0)
+      printf("iter = %d, lambda = %.6e, alpha = %.6e, func = %.14e, best = %.14e\n", iter, lambda, alpha, sign * f, sign * fb);
+
+    if(iter % opt->window == 0)
+    {
+      double rel = (fb - f_window) / fmax(1., fabs(fb));
+      if(rel < opt->tol)
+      {
+        printf("no progress in %u iterations, break\n", opt->window);
+        break;
+      }
+      if(rel < 0.01)
+        alpha_max = fmax(1.e-5, alpha_max / 2.);
+      f_window = fb;
+    }
+  }
+  if(iter >= opt->itermax)
+    printf("max_iter reached\n");
+
+  for(unsigned int i = 0; i < DIMENSION; ++i)
+    res[i] = xb[i];
+
+  time_t t_done = time(NULL);
+  printf("volume done, iterations : %d, improving : %d\n", iter, nr_improve);
+  printf("f_optimal = %e\n", sign * fb);
+  printf("Time stats : total %.1lf\n", difftime(t_done, t_started));
+  return sign * fb;
+}
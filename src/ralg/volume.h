@@ -0,0 +1,52 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <functional> // C++11 std::function
+#include "ralg.h"
+
+// Volume algorithm (Barahona, Anbil 2000), O(dim) memory
+// same callback contract as ralg
+struct volume_options
+{
+    unsigned int itermax; // 3000
+    double lambda; // 0.1, step multiplier
+    double lambda_min; // 1.e-5
+    double alpha_max; // 0.1, weight of the new subgradient in the direction
+    double target_gap; // 0.05, Polyak target is f_best + target_gap * max(1, |f_best|)
+    unsigned int red_limit; // 20, non-improving iterations before lambda is decreased
+    double tol; // 1.e-7, relative improvement over window iterations to stop
+    unsigned int window; // 200
+    bool output;
+    unsigned int output_iter;
+};
+
+const volume_options defaultVolumeOptions = {
+  // itermax
+  3000,
+  // lambda
+  0.1,
+  // lambda_min
+  1.e-5,
+  // alpha_max
+  0.1,
+  // target_gap
+  0.05,
+  // red_limit
+  20,
+  // tol
+  1.e-7,
+  // window
+  200,
+  // output
+  true,
+  // output_iter
+  50
+};
+
+double volume(const volume_options* opt,
+          std::function<bool (const double*, double&, double*)> cb_grad_and_func,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res, bool min=RALG_MIN);
+
+#endif // VOLUME_H